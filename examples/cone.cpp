@@ -0,0 +1,42 @@
+#include "pasta.hpp"
+
+// load only the fanin or fanout cone of some nodes, e.g.,
+// ./cone ../benchmarks/tv80.txt index ../benchmarks/tv80.txt.cone
+// ./cone ../benchmarks/tv80.txt fanin 1000 1001
+// the index (circuit_file.cone) is built once, then every cone is loaded from it
+int main(int argc, char* argv[]) {
+
+  if(argc < 4 || (std::string(argv[2]) != "fanin" && std::string(argv[2]) != "fanout" &&
+                  std::string(argv[2]) != "index")) {
+    std::cerr << "usage: ./example/cone circuit_file fanin|fanout root_name [root_name ...]\n"
+              << "       ./example/cone circuit_file index index_file\n";
+    std::exit(EXIT_FAILURE);
+  }
+
+  std::string circuit_file = argv[1];
+  std::string mode = argv[2];
+
+  if(mode == "index") {
+    try {
+      pasta::Graph::build_cone_index(circuit_file, argv[3]);
+    }
+    catch(const std::runtime_error& e) {
+      std::cerr << e.what() << "\n";
+      std::exit(EXIT_FAILURE);
+    }
+    return 0;
+  }
+
+  std::vector<std::string> roots(argv + 3, argv + argc);
+  auto direction = (mode == "fanin") ? pasta::ConeDirection::Fanin : pasta::ConeDirection::Fanout;
+
+  auto start = std::chrono::steady_clock::now();
+  pasta::Graph graph(circuit_file, roots, direction);
+  auto end = std::chrono::steady_clock::now();
+
+  std::cout << "num_nodes: " << graph.num_nodes() << "\n";
+  std::cout << "num_edges: " << graph.num_edges() << "\n";
+  std::cout << "load_runtime: " << std::chrono::duration_cast<std::chrono::microseconds>(end-start).count() << " us\n";
+
+  return 0;
+}
@@ -0,0 +1,81 @@
+#include "pasta.hpp"
+#include "generator.hpp"
+
+// generate a synthetic DAG in the benchmark text format or the binary graph format, e.g.,
+// ./gen_dag --shape circuit --nodes 10000000 --depth 2000 --binary ../benchmarks/circuit_10m.bin
+int main(int argc, char* argv[]) {
+
+  auto usage = []() {
+    std::cerr << "usage: ./example/gen_dag [--shape layered|random|circuit] [--nodes N] [--depth D] [--width W]\n"
+              << "                         [--degree fixed|uniform|geometric|powerlaw] [--avg-fanin A] [--max-fanin M]\n"
+              << "                         [--exponent E] [--span S] [--locality L] [--seed S] [--binary] output_file\n";
+    std::exit(EXIT_FAILURE);
+  };
+
+  pasta::DagSpec spec;
+  bool binary = false;
+  std::string output_file;
+
+  for(int i=1; i<argc; i++) {
+    std::string arg = argv[i];
+    if(arg == "--binary") {
+      binary = true;
+      continue;
+    }
+    if(arg.rfind("--", 0) != 0) {
+      if(!output_file.empty()) {
+        usage();
+      }
+      output_file = arg;
+      continue;
+    }
+    if(i + 1 == argc) {
+      usage();
+    }
+    std::string value = argv[++i];
+    if(arg == "--shape") {
+      if(value == "layered") spec.shape = pasta::DagShape::Layered;
+      else if(value == "random") spec.shape = pasta::DagShape::Random;
+      else if(value == "circuit") spec.shape = pasta::DagShape::Circuit;
+      else usage();
+    }
+    else if(arg == "--degree") {
+      if(value == "fixed") spec.degree = pasta::DegreeDistribution::Fixed;
+      else if(value == "uniform") spec.degree = pasta::DegreeDistribution::Uniform;
+      else if(value == "geometric") spec.degree = pasta::DegreeDistribution::Geometric;
+      else if(value == "powerlaw") spec.degree = pasta::DegreeDistribution::PowerLaw;
+      else usage();
+    }
+    else if(arg == "--nodes") spec.num_nodes = std::stoull(value);
+    else if(arg == "--depth") spec.depth = std::stoull(value);
+    else if(arg == "--width") spec.width = std::stoull(value);
+    else if(arg == "--avg-fanin") spec.avg_fanin = std::stod(value);
+    else if(arg == "--max-fanin") spec.max_fanin = std::stoull(value);
+    else if(arg == "--exponent") spec.exponent = std::stod(value);
+    else if(arg == "--span") spec.span = std::stoull(value);
+    else if(arg == "--locality") spec.locality = std::stoull(value);
+    else if(arg == "--seed") spec.seed = std::stoull(value);
+    else usage();
+  }
+
+  if(output_file.empty()) {
+    usage();
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  pasta::DagStats stats;
+  try {
+    stats = pasta::generate_dag(spec, output_file, binary);
+  }
+  catch(const std::runtime_error& e) {
+    std::cerr << e.what() << "\n";
+    std::exit(EXIT_FAILURE);
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  std::cout << output_file << ": " << stats.num_nodes << " nodes, " << stats.num_edges << " edges, "
+            << stats.depth << " levels ("
+            << std::chrono::duration_cast<std::chrono::milliseconds>(end-start).count() << " ms)\n";
+
+  return 0;
+}
@@ -0,0 +1,43 @@
+#include "pasta.hpp"
+
+// replay a changelog (e.g., an ECO trace) on a circuit and rerun the
+// cudaflow-partitioned graph after every batch
+int main(int argc, char* argv[]) {
+
+  if(argc != 5) {
+    std::cerr << "usage: ./example/replay matrix_size num_streams circuit_file changelog_file\n";
+    std::exit(EXIT_FAILURE);
+  }
+
+  int matrix_size = std::atoi(argv[1]);
+  int num_streams = std::atoi(argv[2]);
+  std::string circuit_file = argv[3];
+  std::string changelog_file = argv[4];
+
+  pasta::Graph graph(circuit_file);
+
+  std::cout << "benchmark: " << circuit_file << "\n";
+  std::cout << "num_nodes: " << graph.num_nodes() << "\n";
+  std::cout << "num_edges: " << graph.num_edges() << "\n";
+
+  graph.run_graph_cudaflow_partition(matrix_size, num_streams);
+
+  size_t num_batches = 0;
+  try {
+    num_batches = graph.replay(changelog_file, pasta::RunMode::Partition, matrix_size, [&](size_t) {
+      graph.run_graph_cudaflow_partition(matrix_size, num_streams);
+    });
+  }
+  catch(const std::runtime_error& e) {
+    std::cerr << e.what() << "\n";
+    std::exit(EXIT_FAILURE);
+  }
+
+  std::cout << "num_batches: " << num_batches << "\n";
+  std::cout << "num_nodes after replay: " << graph.num_nodes() << "\n";
+  std::cout << "num_edges after replay: " << graph.num_edges() << "\n";
+  std::cout << "total partition runtime with cudaflow partition: " << graph.get_incre_partition_runtime_with_cudaflow_partition() << " us\n"; 
+  std::cout << "total construct runtime with cudaflow partition: " << graph.get_incre_construct_runtime_with_cudaflow() << " us\n"; 
+  std::cout << "total runtime with cudaflow partition: " << graph.get_incre_runtime_with_cudaflow_partition() << " us\n"; 
+  return 0;
+}
@@ -0,0 +1,29 @@
+#include "pasta.hpp"
+
+// convert circuit files in the benchmark text format into the binary graph format,
+// e.g., for f in ../benchmarks/*.txt; do ./txt2bin "$f" "${f%.txt}.bin"; done
+int main(int argc, char* argv[]) {
+
+  if(argc != 3) {
+    std::cerr << "usage: ./example/txt2bin circuit_file binary_file\n";
+    std::exit(EXIT_FAILURE);
+  }
+
+  std::string circuit_file = argv[1];
+  std::string binary_file = argv[2];
+
+  pasta::Graph graph(circuit_file);
+
+  try {
+    graph.save_binary(binary_file);
+  }
+  catch(const std::runtime_error& e) {
+    std::cerr << e.what() << "\n";
+    std::exit(EXIT_FAILURE);
+  }
+
+  std::cout << circuit_file << " -> " << binary_file << " ("
+            << graph.num_nodes() << " nodes, " << graph.num_edges() << " edges)\n";
+
+  return 0;
+}
@@ -15,6 +15,10 @@ run_incre_benchmark() {
   fi
 
   local bench_file="../benchmarks/${benchmark}.txt"
+  # prefer the binary version written by txt2bin, it loads without parsing
+  if [[ -f "../benchmarks/${benchmark}.bin" ]]; then
+    bench_file="../benchmarks/${benchmark}.bin"
+  fi
   if [[ ! -f "$bench_file" ]]; then
     echo "Warning: missing benchmark file: $bench_file (skipping)" >&2
     return 0
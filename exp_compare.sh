@@ -46,6 +46,10 @@ run_incre_cudaflow_partition() {
   local num_incre_ops="$5"
 
   local bench_file="../benchmarks/${benchmark}.txt"
+  # prefer the binary version written by txt2bin, it loads without parsing
+  if [[ -f "../benchmarks/${benchmark}.bin" ]]; then
+    bench_file="../benchmarks/${benchmark}.bin"
+  fi
   [[ ! -f "$bench_file" ]] && return 0
 
   echo "===== Cudaflow: ${benchmark} ====="
@@ -107,6 +111,10 @@ run_incre_semaphore() {
   local num_incre_ops="$5"
 
   local bench_file="../benchmarks/${benchmark}.txt"
+  # prefer the binary version written by txt2bin, it loads without parsing
+  if [[ -f "../benchmarks/${benchmark}.bin" ]]; then
+    bench_file="../benchmarks/${benchmark}.bin"
+  fi
   [[ ! -f "$bench_file" ]] && return 0
 
   echo "===== Semaphore: ${benchmark} ====="
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+// on-disk layout of the binary graph format, shared by Graph::save_binary/load_binary
+// and the DAG generator; not part of the public interface
+
+namespace pasta {
+
+/*
+  binary graph format (version 1), all integers little-endian:
+
+  BinaryHeader
+  names: for each node, varint length followed by the characters
+  edges: for each node, varint out-degree followed by the fanout targets,
+         each as a zigzag varint of the difference to the previous target
+         (the first one relative to the node itself)
+
+  costs (only with BinaryCosts): for each node, varint cost, up to the end of the file
+
+  nodes are numbered by their position in the file, which is the order of Graph::_nodes
+  at the time of saving; fanouts keep their order.
+*/
+inline constexpr char BinaryMagic[8] = {'P', 'A', 'S', 'T', 'A', 'G', 'R', '\0'};
+inline constexpr uint32_t BinaryVersion = 1;
+
+inline constexpr uint32_t BinaryCosts = 1; // node costs follow the edges
+
+struct BinaryHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t flags; // BinaryCosts or 0
+  uint64_t num_nodes;
+  uint64_t num_edges;
+  uint64_t names_bytes;
+  uint64_t edges_bytes;
+};
+
+static_assert(sizeof(BinaryHeader) == 48, "BinaryHeader must not have padding");
+
+inline void put_varint(std::vector<char>& buf, uint64_t v) {
+  while(v >= 0x80) {
+    buf.push_back(static_cast<char>(v | 0x80));
+    v >>= 7;
+  }
+  buf.push_back(static_cast<char>(v));
+}
+
+inline uint64_t get_varint(const char*& p, const char* end) {
+  uint64_t v = 0;
+  for(int shift=0; shift<64; shift+=7) {
+    if(p == end) {
+      throw std::runtime_error("truncated varint");
+    }
+    uint8_t byte = static_cast<uint8_t>(*p++);
+    v |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if((byte & 0x80) == 0) {
+      return v;
+    }
+  }
+  throw std::runtime_error("malformed varint");
+}
+
+inline uint64_t zigzag(int64_t v) {
+  return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+inline int64_t unzigzag(uint64_t v) {
+  return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+}
+
+} // end of namespace pasta
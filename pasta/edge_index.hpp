@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+/**
+@class: EdgeIndex
+
+@tparam T value type (a pointer, nullptr marks an empty bucket)
+
+@brief Open-addressing hash map from a (from, to) id pair to an edge.
+
+The two 32-bit ids are packed into one 64-bit key.
+Buckets are probed linearly and the table doubles once it is half full,
+so probe sequences stay short. Erasure shifts the following entries
+of the cluster back instead of leaving tombstones, so lookups never
+degrade after many insertions and removals.
+
+This class is not thread-safe.
+*/
+template <typename T>
+class EdgeIndex {
+
+  static_assert(std::is_pointer_v<T>, "EdgeIndex stores pointers");
+
+  struct Bucket {
+    uint64_t key {0};
+    T value {nullptr};
+  };
+
+  std::vector<Bucket> _buckets;
+  size_t _mask {0};
+  size_t _size {0};
+
+  static uint64_t _pack(uint32_t from, uint32_t to) noexcept {
+    return (static_cast<uint64_t>(from) << 32) | to;
+  }
+
+  // finalizer of murmur3, spreads the low bits of both ids over the whole word
+  static size_t _hash(uint64_t key) noexcept {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return static_cast<size_t>(key);
+  }
+
+  void _rehash(size_t num_buckets) {
+    std::vector<Bucket> old(num_buckets);
+    old.swap(_buckets);
+    _mask = num_buckets - 1;
+    for(const Bucket& b : old) {
+      if(b.value != nullptr) {
+        size_t i = _hash(b.key) & _mask;
+        while(_buckets[i].value != nullptr) {
+          i = (i + 1) & _mask;
+        }
+        _buckets[i] = b;
+      }
+    }
+  }
+
+  public:
+
+    /**
+    @brief returns the value stored for (from, to), or nullptr if there is none
+    */
+    T find(uint32_t from, uint32_t to) const noexcept {
+      if(_size == 0) {
+        return nullptr;
+      }
+      uint64_t key = _pack(from, to);
+      for(size_t i = _hash(key) & _mask; _buckets[i].value != nullptr; i = (i + 1) & _mask) {
+        if(_buckets[i].key == key) {
+          return _buckets[i].value;
+        }
+      }
+      return nullptr;
+    }
+
+    /**
+    @brief inserts (from, to) -> value
+
+    @return false if (from, to) is already present (the stored value is kept)
+    */
+    bool insert(uint32_t from, uint32_t to, T value) {
+      if(2 * (_size + 1) > _buckets.size()) {
+        _rehash(_buckets.empty() ? 16 : 2 * _buckets.size());
+      }
+      uint64_t key = _pack(from, to);
+      size_t i = _hash(key) & _mask;
+      for(; _buckets[i].value != nullptr; i = (i + 1) & _mask) {
+        if(_buckets[i].key == key) {
+          return false;
+        }
+      }
+      _buckets[i] = {key, value};
+      ++_size;
+      return true;
+    }
+
+    /**
+    @brief removes (from, to) if it is present
+    */
+    void erase(uint32_t from, uint32_t to) noexcept {
+      if(_size == 0) {
+        return;
+      }
+      uint64_t key = _pack(from, to);
+      size_t i = _hash(key) & _mask;
+      for(; _buckets[i].value != nullptr; i = (i + 1) & _mask) {
+        if(_buckets[i].key == key) {
+          break;
+        }
+      }
+      if(_buckets[i].value == nullptr) {
+        return;
+      }
+      // backward-shift deletion: move later entries of the cluster into the hole
+      // unless their home bucket lies cyclically in (hole, j]
+      for(size_t j = (i + 1) & _mask; _buckets[j].value != nullptr; j = (j + 1) & _mask) {
+        size_t home = _hash(_buckets[j].key) & _mask;
+        if(((j - home) & _mask) >= ((j - i) & _mask)) {
+          _buckets[i] = _buckets[j];
+          i = j;
+        }
+      }
+      _buckets[i] = Bucket{};
+      --_size;
+    }
+
+    /**
+    @brief preallocates buckets for n entries
+    */
+    void reserve(size_t n) {
+      size_t num_buckets = 16;
+      while(num_buckets < 2 * n) {
+        num_buckets *= 2;
+      }
+      if(num_buckets > _buckets.size()) {
+        _rehash(num_buckets);
+      }
+    }
+
+    void clear() noexcept {
+      _buckets.clear();
+      _buckets.shrink_to_fit();
+      _mask = 0;
+      _size = 0;
+    }
+
+    size_t size() const noexcept {
+      return _size;
+    }
+};
@@ -0,0 +1,360 @@
+#include "generator.hpp"
+#include "binary_format.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <string_view>
+#include <vector>
+
+namespace pasta {
+
+namespace {
+
+// output file with a 1 MiB write buffer
+class FileSink {
+
+  std::ofstream _out;
+  std::string _path;
+  std::vector<char> _buf;
+  size_t _bytes = 0; // bytes handed to the sink so far
+
+  public:
+
+    explicit FileSink(const std::string& path) : _out {path, std::ios::binary}, _path {path} {
+      if(!_out) {
+        throw std::runtime_error("cannot write " + path);
+      }
+      _buf.reserve(1 << 20);
+    }
+
+    // direct access for put_varint; call commit() afterwards
+    std::vector<char>& buf() {
+      return _buf;
+    }
+
+    void commit() {
+      if(_buf.size() >= (1 << 20)) {
+        flush();
+      }
+    }
+
+    void put(std::string_view s) {
+      _buf.insert(_buf.end(), s.begin(), s.end());
+    }
+
+    void put_uint(uint64_t v) {
+      char digits[20];
+      auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), v);
+      _buf.insert(_buf.end(), digits, end);
+    }
+
+    // bytes written so far, including the buffer
+    size_t bytes() const {
+      return _bytes + _buf.size();
+    }
+
+    void flush() {
+      _out.write(_buf.data(), _buf.size());
+      _bytes += _buf.size();
+      _buf.clear();
+      if(!_out) {
+        throw std::runtime_error("cannot write " + _path);
+      }
+    }
+
+    // overwrite bytes at the given offset after everything has been flushed
+    void rewrite(size_t offset, const void* data, size_t size) {
+      flush();
+      _out.seekp(offset);
+      _out.write(static_cast<const char*>(data), size);
+      _out.seekp(0, std::ios::end);
+      if(!_out) {
+        throw std::runtime_error("cannot write " + _path);
+      }
+    }
+};
+
+// digits of a decimal node name
+size_t name_length(uint64_t v) {
+  size_t len = 1;
+  while(v >= 10) {
+    v /= 10;
+    ++len;
+  }
+  return len;
+}
+
+class DagGenerator {
+
+  const DagSpec& _spec;
+  std::mt19937_64 _gen;
+
+  size_t _n;
+  size_t _width;
+  size_t _depth;
+  size_t _span; // levels a fanin may skip back
+
+  std::vector<uint32_t> _fanins;
+
+  // uniform in [0, bound), Lemire's multiply-shift without the rejection step
+  uint64_t _below(uint64_t bound) {
+    return static_cast<uint64_t>((static_cast<unsigned __int128>(_gen()) * bound) >> 64);
+  }
+
+  // uniform in [0, 1)
+  double _unit() {
+    return static_cast<double>(_gen() >> 11) * 0x1.0p-53;
+  }
+
+  size_t _draw_fanin() {
+    double k = 1;
+    switch(_spec.degree) {
+      case DegreeDistribution::Fixed:
+        k = std::round(_spec.avg_fanin);
+      break;
+      case DegreeDistribution::Uniform:
+        k = 1 + static_cast<double>(_below(std::max<uint64_t>(1, std::llround(2 * _spec.avg_fanin - 1))));
+      break;
+      case DegreeDistribution::Geometric:
+        if(_spec.avg_fanin > 1) {
+          k = 1 + std::floor(std::log1p(-_unit()) / std::log1p(-1 / _spec.avg_fanin));
+        }
+      break;
+      case DegreeDistribution::PowerLaw:
+        k = std::floor(std::pow(1 - _unit(), -1 / (_spec.exponent - 1)));
+      break;
+    }
+    return static_cast<size_t>(std::clamp<double>(k, 1, static_cast<double>(_spec.max_fanin)));
+  }
+
+  // pick one fanin candidate of the node at position pos of level l
+  uint64_t _pick(size_t l, size_t pos) {
+    switch(_spec.shape) {
+      case DagShape::Layered:
+        return begin(l-1) + _below(size(l-1));
+
+      case DagShape::Random: {
+        uint64_t lo = begin(l > _span ? l - _span : 0);
+        return lo + _below(begin(l) - lo);
+      }
+
+      case DagShape::Circuit:
+      default: {
+        // mostly the previous level, each further level half as likely
+        size_t d = 1;
+        while(d < _span && d < l && (_gen() & 1)) {
+          ++d;
+        }
+        size_t src = l - d;
+        // an occasional long wire, otherwise a window around the matching position
+        if(_below(16) == 0) {
+          return begin(src) + _below(size(src));
+        }
+        int64_t center = static_cast<int64_t>(pos * size(src) / size(l));
+        int64_t offset = static_cast<int64_t>(_below(2 * _spec.locality + 1)) - static_cast<int64_t>(_spec.locality);
+        int64_t p = std::clamp<int64_t>(center + offset, 0, static_cast<int64_t>(size(src)) - 1);
+        return begin(src) + static_cast<uint64_t>(p);
+      }
+    }
+  }
+
+  public:
+
+    DagGenerator(const DagSpec& spec) : _spec {spec}, _gen {spec.seed} {
+
+      if(spec.avg_fanin <= 0 || spec.max_fanin == 0) {
+        throw std::runtime_error("avg_fanin and max_fanin must be positive");
+      }
+      if(spec.degree == DegreeDistribution::PowerLaw && spec.exponent <= 1) {
+        throw std::runtime_error("the power-law exponent must be larger than 1");
+      }
+
+      _n = spec.num_nodes ? spec.num_nodes : spec.depth * spec.width;
+      if(_n == 0) {
+        throw std::runtime_error("the DAG needs at least one node");
+      }
+      if(_n > std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("node ids must fit in 32 bits");
+      }
+      size_t depth = spec.depth;
+      if(depth == 0 && spec.width == 0) {
+        depth = std::max<size_t>(1, std::llround(std::sqrt(static_cast<double>(_n))));
+      }
+      _width = spec.width ? spec.width : (_n + depth - 1) / depth;
+      _depth = (_n + _width - 1) / _width;
+
+      switch(spec.shape) {
+        case DagShape::Layered:
+          _span = 1;
+        break;
+        case DagShape::Random:
+          _span = spec.span ? spec.span : 16;
+        break;
+        case DagShape::Circuit:
+          _span = spec.span ? spec.span : 4;
+        break;
+      }
+      _span = std::min(_span, _depth);
+    }
+
+    size_t num_nodes() const { return _n; }
+    size_t depth() const { return _depth; }
+    size_t span() const { return _span; }
+
+    size_t begin(size_t l) const { return l * _width; }
+    size_t end(size_t l) const { return std::min(_n, (l + 1) * _width); }
+    size_t size(size_t l) const { return end(l) - begin(l); }
+    size_t level_of(size_t v) const { return v / _width; }
+
+    // call on_edge(from, to) for every fanin of every node in level l,
+    // grouped by the target node in increasing order
+    template <typename F>
+    void level(size_t l, F&& on_edge) {
+      if(l == 0) {
+        return;
+      }
+      // distinct fanins exist only as long as there are candidates
+      const size_t num_candidates = begin(l) - begin(l > _span ? l - _span : 0);
+      for(size_t v=begin(l); v<end(l); v++) {
+        size_t k = std::min(_draw_fanin(), num_candidates);
+        _fanins.clear();
+        for(size_t tries=0; _fanins.size() < k && tries < 4 * k; tries++) {
+          uint32_t u = static_cast<uint32_t>(_pick(l, v - begin(l)));
+          if(std::find(_fanins.begin(), _fanins.end(), u) == _fanins.end()) {
+            _fanins.push_back(u);
+          }
+        }
+        for(uint32_t u : _fanins) {
+          on_edge(u, static_cast<uint32_t>(v));
+        }
+      }
+    }
+};
+
+DagStats write_text(DagGenerator& dag, FileSink& out) {
+
+  DagStats stats {dag.num_nodes(), 0, dag.depth()};
+
+  out.put_uint(dag.num_nodes());
+  out.put("\n");
+  for(size_t v=0; v<dag.num_nodes(); v++) {
+    out.put("\"");
+    out.put_uint(v);
+    out.put("\";\n");
+    out.commit();
+  }
+
+  // edges can be written in any order, so they go out as they are drawn
+  for(size_t l=0; l<dag.depth(); l++) {
+    dag.level(l, [&](uint32_t from, uint32_t to) {
+      out.put("\"");
+      out.put_uint(from);
+      out.put("\" -> \"");
+      out.put_uint(to);
+      out.put("\";\n");
+      out.commit();
+      ++stats.num_edges;
+    });
+  }
+
+  out.flush();
+  return stats;
+}
+
+DagStats write_binary(DagGenerator& dag, FileSink& out) {
+
+  DagStats stats {dag.num_nodes(), 0, dag.depth()};
+
+  BinaryHeader header;
+  std::memcpy(header.magic, BinaryMagic, sizeof(BinaryMagic));
+  header.version = BinaryVersion;
+  header.flags = 0;
+  header.num_nodes = dag.num_nodes();
+  header.num_edges = 0;
+  header.names_bytes = 0;
+  header.edges_bytes = 0;
+  out.buf().insert(out.buf().end(), reinterpret_cast<const char*>(&header),
+                   reinterpret_cast<const char*>(&header) + sizeof(header));
+
+  for(size_t v=0; v<dag.num_nodes(); v++) {
+    put_varint(out.buf(), name_length(v));
+    out.put_uint(v);
+    out.commit();
+  }
+  header.names_bytes = out.bytes() - sizeof(header);
+
+  /*
+   * the binary format groups edges by source, but they are drawn by target.
+   * an edge drawn in level l starts at most span levels back, so once level l is drawn
+   * the fanouts of level l - span are complete: its edges are bucketed by source
+   * level and a bucket is written out (counting-sorted by source) as soon as it is final.
+   */
+  const size_t span = dag.span();
+  std::vector<std::vector<std::pair<uint32_t, uint32_t>>> buckets(span + 1);
+  std::vector<size_t> offsets;
+  std::vector<uint32_t> fanouts;
+
+  auto finalize = [&](size_t l) {
+    auto& bucket = buckets[l % (span + 1)];
+    const size_t begin = dag.begin(l);
+    offsets.assign(dag.size(l) + 1, 0);
+    for(auto [from, to] : bucket) {
+      ++offsets[from - begin + 1];
+    }
+    for(size_t i=1; i<offsets.size(); i++) {
+      offsets[i] += offsets[i-1];
+    }
+    fanouts.resize(bucket.size());
+    // targets were drawn in increasing order, and the stable placement keeps it
+    for(auto [from, to] : bucket) {
+      fanouts[offsets[from - begin]++] = to;
+    }
+    size_t first = 0;
+    for(size_t i=0; i<dag.size(l); i++) {
+      size_t last = offsets[i];
+      put_varint(out.buf(), last - first);
+      int64_t prev = static_cast<int64_t>(begin + i);
+      for(size_t e=first; e<last; e++) {
+        put_varint(out.buf(), zigzag(static_cast<int64_t>(fanouts[e]) - prev));
+        prev = fanouts[e];
+      }
+      out.commit();
+      first = last;
+    }
+    stats.num_edges += bucket.size();
+    bucket.clear();
+  };
+
+  for(size_t l=0; l<dag.depth(); l++) {
+    dag.level(l, [&](uint32_t from, uint32_t to) {
+      buckets[dag.level_of(from) % (span + 1)].emplace_back(from, to);
+    });
+    if(l >= span) {
+      finalize(l - span);
+    }
+  }
+  for(size_t l=(dag.depth() > span ? dag.depth() - span : 0); l<dag.depth(); l++) {
+    finalize(l);
+  }
+
+  out.flush();
+  header.num_edges = stats.num_edges;
+  header.edges_bytes = out.bytes() - sizeof(header) - header.names_bytes;
+  out.rewrite(0, &header, sizeof(header));
+  return stats;
+}
+
+} // end of anonymous namespace
+
+DagStats generate_dag(const DagSpec& spec, const std::string& path, bool binary) {
+  DagGenerator dag(spec);
+  FileSink out(path);
+  return binary ? write_binary(dag, out) : write_text(dag, out);
+}
+
+} // end of namespace pasta
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace pasta {
+
+enum class DagShape {
+  Layered,  // fanins come from the previous level only
+  Random,   // fanins come from any of the previous span levels, uniformly
+  Circuit   // fanin cones: fanins come from nearby positions of the last few levels,
+            // so neighbouring nodes share fanins and paths reconverge
+};
+
+enum class DegreeDistribution {
+  Fixed,      // every non-source node has avg_fanin fanins
+  Uniform,    // uniform in [1, 2 * avg_fanin - 1]
+  Geometric,  // 1 + geometric with mean avg_fanin
+  PowerLaw    // Pareto tail with the given exponent, a few nodes get very large fanins
+};
+
+/*
+ * parameters of a synthetic DAG.
+ * nodes are split into depth levels of width nodes each (the last level may be smaller),
+ * level 0 holds the sources and every other node draws its fanin count from degree,
+ * capped by max_fanin, and picks distinct fanins from earlier levels.
+ * at most two of num_nodes, depth and width are needed: with both depth and width 0
+ * the depth is about sqrt(num_nodes), with num_nodes 0 it is depth * width.
+ */
+struct DagSpec {
+  DagShape shape = DagShape::Layered;
+  size_t num_nodes = 1000;
+  size_t depth = 0;
+  size_t width = 0;
+
+  DegreeDistribution degree = DegreeDistribution::Uniform;
+  double avg_fanin = 2.0;
+  size_t max_fanin = 16;
+  double exponent = 2.5; // PowerLaw only
+
+  size_t span = 0;       // levels a fanin may skip back: Random (0 = 16), Circuit (0 = 4)
+  size_t locality = 8;   // Circuit only: half-width of the fanin window within a level
+
+  uint64_t seed = 0;
+};
+
+struct DagStats {
+  size_t num_nodes = 0;
+  size_t num_edges = 0;
+  size_t depth = 0;
+};
+
+// write the DAG described by spec to path, in the benchmark text format or in the
+// binary graph format (see Graph::save_binary); node i is named "i" and nodes are
+// numbered level by level. the graph is streamed to the file and never built in memory,
+// only the fanouts of the last span levels are buffered for the binary format, so a
+// large explicit span (up to depth) trades memory for longer edges.
+// the same spec and seed give the same graph in both formats.
+// throws std::runtime_error on an invalid spec or if the file cannot be written
+DagStats generate_dag(const DagSpec& spec, const std::string& path, bool binary = false);
+
+} // end of namespace pasta
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+@class: MappedFile
+
+@brief Read-only memory mapping of a whole file.
+
+The contents are exposed as a std::string_view that stays valid
+for the lifetime of the object. An empty file maps to an empty view.
+Opening or mapping failures throw std::runtime_error.
+*/
+class MappedFile {
+
+  int _fd {-1};
+  const char* _data {nullptr};
+  size_t _size {0};
+
+  public:
+
+    explicit MappedFile(const std::string& path) {
+      _fd = ::open(path.c_str(), O_RDONLY);
+      if(_fd < 0) {
+        throw std::runtime_error("cannot open " + path);
+      }
+      struct stat st;
+      if(::fstat(_fd, &st) != 0) {
+        ::close(_fd);
+        throw std::runtime_error("cannot stat " + path);
+      }
+      _size = static_cast<size_t>(st.st_size);
+      if(_size > 0) {
+        void* p = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+        if(p == MAP_FAILED) {
+          ::close(_fd);
+          throw std::runtime_error("cannot map " + path);
+        }
+        ::madvise(p, _size, MADV_SEQUENTIAL);
+        _data = static_cast<const char*>(p);
+      }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator = (const MappedFile&) = delete;
+
+    ~MappedFile() {
+      if(_data) {
+        ::munmap(const_cast<char*>(_data), _size);
+      }
+      if(_fd >= 0) {
+        ::close(_fd);
+      }
+    }
+
+    std::string_view view() const noexcept {
+      return {_data, _size};
+    }
+};
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <string_view>
+#include <vector>
+
+/**
+@class: NameTable
+
+@brief Interned names indexed by a dense id, with a hash index from name to id.
+
+All characters live in one arena and every id keeps only an offset
+and a length into it, so a name costs 8 bytes plus its characters
+instead of a std::string. Non-empty names are also put in an
+open-addressing hash index. Each bucket holds an id and the 32-bit
+hash of its name. Different ids can share a name. find() then returns
+one of them.
+
+Erased names leave dead bytes in the arena. The arena is compacted
+once dead bytes outnumber live ones. Offsets move during compaction,
+so a string_view returned by operator [] is only valid until the next
+set() or erase().
+
+This class is not thread-safe.
+*/
+class NameTable {
+
+  static constexpr uint32_t Empty = std::numeric_limits<uint32_t>::max();
+
+  struct Bucket {
+    uint32_t id {Empty};
+    uint32_t hash {0};
+  };
+
+  std::vector<char> _chars;
+  std::vector<uint32_t> _offset;
+  std::vector<uint32_t> _length;
+  size_t _dead {0};
+
+  std::vector<Bucket> _buckets;
+  size_t _mask {0};
+  size_t _size {0};
+
+  static uint32_t _hash(std::string_view name) noexcept {
+    return static_cast<uint32_t>(std::hash<std::string_view>{}(name));
+  }
+
+  void _rehash(size_t num_buckets) {
+    std::vector<Bucket> old(num_buckets);
+    old.swap(_buckets);
+    _mask = num_buckets - 1;
+    for(const Bucket& b : old) {
+      if(b.id != Empty) {
+        size_t i = b.hash & _mask;
+        while(_buckets[i].id != Empty) {
+          i = (i + 1) & _mask;
+        }
+        _buckets[i] = b;
+      }
+    }
+  }
+
+  void _index(uint32_t id, uint32_t hash) {
+    if(2 * (_size + 1) > _buckets.size()) {
+      _rehash(_buckets.empty() ? 16 : 2 * _buckets.size());
+    }
+    size_t i = hash & _mask;
+    while(_buckets[i].id != Empty) {
+      i = (i + 1) & _mask;
+    }
+    _buckets[i] = {id, hash};
+    ++_size;
+  }
+
+  void _unindex(uint32_t id, uint32_t hash) noexcept {
+    size_t i = hash & _mask;
+    while(_buckets[i].id != id) {
+      i = (i + 1) & _mask;
+    }
+    // backward-shift deletion, see EdgeIndex::erase
+    for(size_t j = (i + 1) & _mask; _buckets[j].id != Empty; j = (j + 1) & _mask) {
+      size_t home = _buckets[j].hash & _mask;
+      if(((j - home) & _mask) >= ((j - i) & _mask)) {
+        _buckets[i] = _buckets[j];
+        i = j;
+      }
+    }
+    _buckets[i] = Bucket{};
+    --_size;
+  }
+
+  void _compact() {
+    std::vector<char> chars;
+    chars.reserve(_chars.size() - _dead);
+    for(size_t id=0; id<_offset.size(); id++) {
+      const char* begin = _chars.data() + _offset[id];
+      _offset[id] = static_cast<uint32_t>(chars.size());
+      chars.insert(chars.end(), begin, begin + _length[id]);
+    }
+    _chars.swap(chars);
+    _dead = 0;
+  }
+
+  public:
+
+    /**
+    @brief returns the number of ids
+    */
+    size_t size() const noexcept {
+      return _offset.size();
+    }
+
+    /**
+    @brief grows (or shrinks) the id space, new ids have an empty name
+    */
+    void resize(size_t n) {
+      _offset.resize(n, 0);
+      _length.resize(n, 0);
+    }
+
+    /**
+    @brief returns the name of an id
+    */
+    std::string_view operator [] (size_t id) const noexcept {
+      return {_chars.data() + _offset[id], _length[id]};
+    }
+
+    /**
+    @brief names an id that currently has an empty name
+    */
+    void set(uint32_t id, std::string_view name) {
+      if(name.empty()) {
+        return;
+      }
+      _offset[id] = static_cast<uint32_t>(_chars.size());
+      _length[id] = static_cast<uint32_t>(name.size());
+      _chars.insert(_chars.end(), name.begin(), name.end());
+      _index(id, _hash(name));
+    }
+
+    /**
+    @brief clears the name of an id
+    */
+    void erase(uint32_t id) {
+      if(_length[id] == 0) {
+        return;
+      }
+      _unindex(id, _hash((*this)[id]));
+      _dead += _length[id];
+      _offset[id] = 0;
+      _length[id] = 0;
+      if(_dead > 4096 && 2 * _dead > _chars.size()) {
+        _compact();
+      }
+    }
+
+    /**
+    @brief returns an id with the given name, or the maximum uint32_t if there is none
+    */
+    uint32_t find(std::string_view name) const noexcept {
+      if(_size == 0 || name.empty()) {
+        return Empty;
+      }
+      uint32_t hash = _hash(name);
+      for(size_t i = hash & _mask; _buckets[i].id != Empty; i = (i + 1) & _mask) {
+        if(_buckets[i].hash == hash && (*this)[_buckets[i].id] == name) {
+          return _buckets[i].id;
+        }
+      }
+      return Empty;
+    }
+};
@@ -1,608 +1,3767 @@
 #include "pasta.hpp"
+#include "binary_format.hpp"
 
 namespace pasta {
 
+namespace {
+
+// in-place tokenizer of the benchmark .txt format
+struct TextCursor {
+
+  const char* cur;
+  const char* end;
+
+  void skip_space() {
+    while(cur < end && std::isspace(static_cast<unsigned char>(*cur))) {
+      ++cur;
+    }
+  }
+
+  bool eof() {
+    skip_space();
+    return cur == end;
+  }
+
+  bool number(size_t& n) {
+    skip_space();
+    auto [p, ec] = std::from_chars(cur, end, n);
+    if(ec != std::errc()) {
+      return false;
+    }
+    cur = p;
+    return true;
+  }
+
+  bool literal(std::string_view lit) {
+    skip_space();
+    if(static_cast<size_t>(end - cur) < lit.size() || std::string_view(cur, lit.size()) != lit) {
+      return false;
+    }
+    cur += lit.size();
+    return true;
+  }
+
+  // "name" -> view of name inside the buffer
+  bool quoted(std::string_view& name) {
+    skip_space();
+    if(cur == end || *cur != '"') {
+      return false;
+    }
+    const char* beg = ++cur;
+    const char* quote = static_cast<const char*>(std::memchr(beg, '"', end - beg));
+    if(!quote) {
+      return false;
+    }
+    name = std::string_view(beg, quote - beg);
+    cur = quote + 1;
+    return true;
+  }
+
+  // node declaration: "name"; or "name" cost; where cost is a positive integer (default 1)
+  bool declaration(std::string_view& name, uint32_t& cost) {
+    if(!quoted(name)) {
+      return false;
+    }
+    cost = 1;
+    if(literal(";")) {
+      return true;
+    }
+    size_t n;
+    if(!number(n) || n == 0 || n > std::numeric_limits<uint32_t>::max()) {
+      return false;
+    }
+    cost = static_cast<uint32_t>(n);
+    return literal(";");
+  }
+};
+
+// the synthetic work of a node: cost products of two matrix_size x matrix_size matrices
+void run_task(size_t matrix_size, uint32_t cost) {
+  for(uint32_t r=0; r<cost; r++) {
+    // std::this_thread::sleep_for(std::chrono::nanoseconds(task_runtime));
+    size_t N = matrix_size;
+    size_t M = matrix_size;
+    size_t K = matrix_size;
+    std::vector<int> A(N*K, 1);
+    std::vector<int> B(K*M, 2);
+    std::vector<int> C(N*M);
+    for(size_t n=0; n<N; n++) {
+      for(size_t m=0; m<M; m++) {
+        int temp = 0;
+        for(size_t k=0; k<K; k++) {
+          temp += A[n*K + k] * B[k*M + m];
+        }
+        C[n*M + m] = temp;
+      }
+    }
+  }
+}
+
+std::string_view get_name(const char*& p, const char* end) {
+  uint64_t len = get_varint(p, end);
+  if(len > static_cast<uint64_t>(end - p)) {
+    throw std::runtime_error("truncated node name");
+  }
+  std::string_view name(p, len);
+  p += len;
+  return name;
+}
+
+/*
+  partition file format (version 1), all integers little-endian:
+
+  PartitionHeader
+  names: node names as in the binary graph format
+  body: for each node
+        - PartitionCPasta: zigzag varint cluster id
+        - PartitionStreams: zigzag varint lid, varint number of reconstructed fanouts
+          followed by their positions, and the position of the extra fanout plus one
+          (0 if there is none)
+
+  nodes are numbered by their position in the file, which is the order of Graph::_nodes
+  at the time of saving. graph_hash is Graph::content_hash() of the saved graph.
+*/
+constexpr char PartitionMagic[8] = {'P', 'A', 'S', 'T', 'A', 'P', 'T', '\0'};
+constexpr uint32_t PartitionVersion = 1;
+
+constexpr uint32_t PartitionCPasta = 1;      // cluster ids of partition_c_pasta
+constexpr uint32_t PartitionStreams = 2;     // reconstructed edges of partition_cudaflow(_incremental)
+constexpr uint32_t PartitionIncremental = 4; // the streams came from partition_cudaflow_incremental
+
+struct PartitionHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t flags;
+  uint64_t graph_hash;
+  uint64_t partition_size;
+  uint64_t num_streams;
+  uint64_t num_nodes;
+  int64_t max_cluster_id;
+  uint64_t names_bytes;
+  uint64_t body_bytes;
+};
+
+static_assert(sizeof(PartitionHeader) == 72, "PartitionHeader must not have padding");
+
+// binary changelog, see ChangelogReader
+constexpr char ChangelogMagic[8] = {'P', 'A', 'S', 'T', 'A', 'C', 'L', '\0'};
+constexpr uint32_t ChangelogVersion = 1;
+
+enum ChangelogOp : uint8_t {
+  ChangelogRemoveEdge = 0,
+  ChangelogRemoveNode = 1,
+  ChangelogInsertNode = 2,
+  ChangelogInsertEdge = 3
+};
+
+// 64-bit FNV-1a, stable across platforms and standard libraries
+uint64_t fnv1a(std::string_view s) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for(char c : s) {
+    h ^= static_cast<uint8_t>(c);
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+// finalizer of splitmix64
+inline uint64_t mix64(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+/*
+  cone index (version 3) of a graph file, all integers little-endian:
+
+  ConeIndexHeader
+  uint64 name_offsets[num_nodes]       byte offset of each node name in the graph file
+  uint64 fanout_offsets[num_nodes+1]   CSR of fanouts by node position
+  uint64 fanin_offsets[num_nodes+1]    CSR of fanins by node position
+  uint32 name_lengths[num_nodes]
+  uint32 costs[num_nodes]              node costs, 1 if the graph file has none
+  uint32 fanouts[num_edges]            in the order of the graph file
+  uint32 fanins[num_edges]
+  uint32 names[table_size]             open-addressed name table, see below
+
+  nodes are numbered by their position in the graph file. the 64-bit arrays come first,
+  so every array is aligned when the index is mapped.
+  the name table holds position + 1 of every node (0 is an empty slot) at the first free
+  slot from fnv1a(name) mod table_size on, table_size is a power of two of at least twice
+  the number of nodes. a lookup probes from the slot of the name to the next empty one,
+  so it reads the graph file only for the names of the same length it meets on the way.
+*/
+constexpr char ConeIndexMagic[8] = {'P', 'A', 'S', 'T', 'A', 'C', 'I', '\0'};
+constexpr uint32_t ConeIndexVersion = 3;
+
+struct ConeIndexHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t flags; // reserved, 0
+  uint64_t num_nodes;
+  uint64_t num_edges;
+  uint64_t graph_bytes; // size of the indexed graph file
+  uint64_t graph_hash;  // file_hash of the indexed graph file, to detect a stale index
+  uint64_t table_size;
+};
+
+static_assert(sizeof(ConeIndexHeader) == 56, "ConeIndexHeader must not have padding");
+
+// arrays of a cone index, pointing into its bytes
+struct ConeIndex {
+  uint64_t num_nodes;
+  uint64_t table_size;
+  const uint64_t* name_offsets;
+  const uint64_t* fanout_offsets;
+  const uint64_t* fanin_offsets;
+  const uint32_t* name_lengths;
+  const uint32_t* costs;
+  const uint32_t* fanouts;
+  const uint32_t* fanins;
+  const uint32_t* names;
+};
+
+// smallest power of two of at least twice the number of nodes
+inline uint64_t cone_table_size(uint64_t num_nodes) {
+  uint64_t size = 2;
+  while(size < 2 * num_nodes) {
+    size *= 2;
+  }
+  return size;
+}
+
+// whether index is a cone index of a graph file of graph_bytes bytes hashing to graph_hash
+bool cone_index_matches(std::string_view index, size_t graph_bytes, uint64_t graph_hash) {
+  ConeIndexHeader header;
+  if(index.size() < sizeof(header)) {
+    return false;
+  }
+  std::memcpy(&header, index.data(), sizeof(header));
+  return std::memcmp(header.magic, ConeIndexMagic, sizeof(ConeIndexMagic)) == 0 &&
+         header.version == ConeIndexVersion && header.graph_bytes == graph_bytes &&
+         header.graph_hash == graph_hash;
+}
+
+ConeIndex parse_cone_index(std::string_view index) {
+
+  ConeIndexHeader header;
+  std::memcpy(&header, index.data(), sizeof(header));
+  const uint64_t n = header.num_nodes;
+  const uint64_t m = header.num_edges;
+  const uint64_t t = header.table_size;
+  if(t != cone_table_size(n) ||
+     index.size() != sizeof(header) + 8 * (3 * n + 2) + 4 * (2 * n + 2 * m + t)) {
+    throw std::runtime_error("cone index size does not match its header");
+  }
+
+  const char* p = index.data() + sizeof(header);
+  ConeIndex ci;
+  ci.num_nodes = n;
+  ci.name_offsets = reinterpret_cast<const uint64_t*>(p);
+  ci.fanout_offsets = ci.name_offsets + n;
+  ci.fanin_offsets = ci.fanout_offsets + n + 1;
+  ci.name_lengths = reinterpret_cast<const uint32_t*>(ci.fanin_offsets + n + 1);
+  ci.costs = ci.name_lengths + n;
+  ci.fanouts = ci.costs + n;
+  ci.fanins = ci.fanouts + m;
+  ci.table_size = t;
+  ci.names = ci.fanins + m;
+  if(ci.fanout_offsets[n] != m || ci.fanin_offsets[n] != m) {
+    throw std::runtime_error("cone index edge count does not match its header");
+  }
+  return ci;
+}
+
+// one pass over a text or binary graph file whose file_hash is graph_hash
+std::vector<char> make_cone_index(std::string_view data, uint64_t graph_hash) {
+
+  std::vector<uint64_t> name_offsets;
+  std::vector<uint32_t> name_lengths;
+  std::vector<uint32_t> costs;
+  std::vector<std::pair<uint32_t, uint32_t>> edges; // in file order
+  auto add_name = [&](std::string_view name) {
+    name_offsets.push_back(name.data() - data.data());
+    name_lengths.push_back(static_cast<uint32_t>(name.size()));
+  };
+
+  if(data.substr(0, sizeof(BinaryMagic)) == std::string_view(BinaryMagic, sizeof(BinaryMagic))) {
+    BinaryHeader header;
+    if(data.size() < sizeof(header)) {
+      throw std::runtime_error("truncated binary graph header");
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if(header.version != BinaryVersion) {
+      throw std::runtime_error("unsupported binary graph version " + std::to_string(header.version));
+    }
+    // the cost section has no size of its own, it runs to the end of the file
+    const size_t size = sizeof(header) + header.names_bytes + header.edges_bytes;
+    if((header.flags & BinaryCosts) ? size >= data.size() : size != data.size()) {
+      throw std::runtime_error("binary graph size does not match its header");
+    }
+    const char* p = data.data() + sizeof(header);
+    const char* names_end = p + header.names_bytes;
+    const char* edges_end = names_end + header.edges_bytes;
+    const char* costs_end = data.data() + data.size();
+    const int64_t n = static_cast<int64_t>(header.num_nodes);
+    name_offsets.reserve(n);
+    name_lengths.reserve(n);
+    for(int64_t v=0; v<n; v++) {
+      add_name(get_name(p, names_end));
+    }
+    p = names_end;
+    edges.reserve(header.num_edges);
+    for(int64_t v=0; v<n; v++) {
+      uint64_t degree = get_varint(p, edges_end);
+      int64_t prev = v;
+      for(uint64_t k=0; k<degree; k++) {
+        int64_t to = prev + unzigzag(get_varint(p, edges_end));
+        if(to < 0 || to >= n) {
+          throw std::runtime_error("edge target out of range");
+        }
+        edges.emplace_back(static_cast<uint32_t>(v), static_cast<uint32_t>(to));
+        prev = to;
+      }
+    }
+    costs.assign(n, 1);
+    if(header.flags & BinaryCosts) {
+      p = edges_end;
+      for(int64_t v=0; v<n; v++) {
+        uint64_t cost = get_varint(p, costs_end);
+        if(cost == 0 || cost > std::numeric_limits<uint32_t>::max()) {
+          throw std::runtime_error("node cost out of range");
+        }
+        costs[v] = static_cast<uint32_t>(cost);
+      }
+    }
+  }
+  else {
+    TextCursor in {data.data(), data.data() + data.size()};
+    size_t n;
+    if(!in.number(n)) {
+      throw std::runtime_error("missing number of nodes");
+    }
+    NameTable names;
+    names.resize(n);
+    std::string_view name;
+    uint32_t cost;
+    for(size_t i=0; i<n; i++) {
+      if(!in.declaration(name, cost)) {
+        throw std::runtime_error("malformed node declaration " + std::to_string(i));
+      }
+      add_name(name);
+      costs.push_back(cost);
+      names.set(static_cast<uint32_t>(i), name);
+    }
+    std::string_view from, to;
+    while(!in.eof()) {
+      if(!in.quoted(from) || !in.literal("->") || !in.quoted(to) || !in.literal(";")) {
+        throw std::runtime_error("malformed edge");
+      }
+      uint32_t u = names.find(from);
+      uint32_t v = names.find(to);
+      if(u >= n || v >= n) {
+        throw std::runtime_error("edge \"" + std::string(from) + "\" -> \"" + std::string(to) +
+                                 "\" refers to an undeclared node");
+      }
+      edges.emplace_back(u, v);
+    }
+  }
+
+  const size_t n = name_offsets.size();
+  const size_t m = edges.size();
+
+  // counting sort by source and by target, both stable so file order is kept
+  auto csr = [&edges, n, m](auto key, auto value, std::vector<uint64_t>& offsets, std::vector<uint32_t>& adj) {
+    offsets.assign(n + 1, 0);
+    for(const auto& e : edges) {
+      ++offsets[key(e) + 1];
+    }
+    for(size_t i=1; i<=n; i++) {
+      offsets[i] += offsets[i-1];
+    }
+    std::vector<uint64_t> pos(offsets.begin(), offsets.end() - 1);
+    adj.resize(m);
+    for(const auto& e : edges) {
+      adj[pos[key(e)]++] = value(e);
+    }
+  };
+  auto first = [](const std::pair<uint32_t, uint32_t>& e) { return e.first; };
+  auto second = [](const std::pair<uint32_t, uint32_t>& e) { return e.second; };
+  std::vector<uint64_t> fanout_offsets, fanin_offsets;
+  std::vector<uint32_t> fanouts, fanins;
+  csr(first, second, fanout_offsets, fanouts);
+  csr(second, first, fanin_offsets, fanins);
+
+  const uint64_t table_size = cone_table_size(n);
+  std::vector<uint32_t> names(table_size, 0);
+  for(size_t v=0; v<n; v++) {
+    uint64_t slot = fnv1a(data.substr(name_offsets[v], name_lengths[v])) & (table_size - 1);
+    while(names[slot] != 0) {
+      slot = (slot + 1) & (table_size - 1);
+    }
+    names[slot] = static_cast<uint32_t>(v + 1);
+  }
+
+  ConeIndexHeader header;
+  std::memcpy(header.magic, ConeIndexMagic, sizeof(ConeIndexMagic));
+  header.version = ConeIndexVersion;
+  header.flags = 0;
+  header.num_nodes = n;
+  header.num_edges = m;
+  header.graph_bytes = data.size();
+  header.graph_hash = graph_hash;
+  header.table_size = table_size;
+
+  std::vector<char> index;
+  index.reserve(sizeof(header) + 8 * (3 * n + 2) + 4 * (2 * n + 2 * m + table_size));
+  auto append = [&index](const auto* p, size_t count) {
+    const char* bytes = reinterpret_cast<const char*>(p);
+    index.insert(index.end(), bytes, bytes + count * sizeof(*p));
+  };
+  append(&header, 1);
+  append(name_offsets.data(), n);
+  append(fanout_offsets.data(), n + 1);
+  append(fanin_offsets.data(), n + 1);
+  append(name_lengths.data(), n);
+  append(costs.data(), n);
+  append(fanouts.data(), m);
+  append(fanins.data(), m);
+  append(names.data(), table_size);
+  return index;
+}
+
+// partition_c_pasta uses one thread per this many nodes, up to the number of workers
+constexpr size_t CPastaNodesPerThread = 512;
+
+// an idle C-PASTA worker retries its steal sweep this many times with a growing pause,
+// then yields this many more times before it parks until new work is released
+constexpr size_t CPastaSpinRounds = 8;
+constexpr size_t CPastaYieldRounds = 8;
+
+// critical successor of a node off the critical paths (CPastaStrategy::CriticalPath)
+constexpr uint32_t NotCritical = std::numeric_limits<uint32_t>::max();
+
+// reservation of a cluster no node of the level has claimed (deterministic C-PASTA)
+constexpr uint32_t Unreserved = std::numeric_limits<uint32_t>::max();
+
+// end of a chain, and the supernode of a free id (chain compression)
+constexpr uint32_t NoNode = std::numeric_limits<uint32_t>::max();
+
+// hint to the core that we are busy-waiting
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
+// ranks of incremental C-PASTA spread the clusters over [0, 2^62], so clusters opened
+// one after another can halve the gap to their neighbour 62 - log2(clusters) times
+// before all ranks are spread out again
+constexpr uint64_t ClusterRankSpan = uint64_t{1} << 62;
+
+inline uint64_t cluster_rank_gap(size_t num_clusters) {
+  return std::max<uint64_t>(2, ClusterRankSpan / (num_clusters + 1));
+}
+
+// a cluster takes a node as long as its total cost stays within the budget;
+// an empty cluster takes any node, so a node costlier than the budget gets one of its own
+inline bool fits(size_t cluster_cost, uint32_t cost, size_t budget) {
+  return cluster_cost == 0 || cluster_cost + cost <= budget;
+}
+
+/*
+ * joins the tasks one call hands to the executor, and only those.
+ * the caller must be able to finish the work on its own: close() stops the tasks that
+ * have not started yet from running and waits for the ones that have, so the call never
+ * waits on a task the executor cannot start, e.g. when the call itself runs on a worker.
+ * the state is shared with the tasks because the late ones still run after close() returns.
+ */
+class TaskJoin {
+
+  public:
+
+    TaskJoin() = default;
+    TaskJoin(const TaskJoin&) = delete;
+    TaskJoin& operator=(const TaskJoin&) = delete;
+
+    ~TaskJoin() {
+      close();
+    }
+
+    // run f on the executor unless the join is closed by the time it starts
+    template <typename F>
+    void async(tf::Executor& executor, F&& f) {
+      executor.silent_async([state = _state, f = std::forward<F>(f)]() mutable {
+        if((state->fetch_add(1, std::memory_order_acquire) & Closed) == 0) {
+          f();
+        }
+        if(state->fetch_sub(1, std::memory_order_acq_rel) == (Closed | 1)) {
+          state->notify_all();
+        }
+      });
+    }
+
+    // stop the tasks that did not start and wait for the running ones
+    void close() {
+      uint64_t s = _state->fetch_or(Closed, std::memory_order_acq_rel) | Closed;
+      while(s != Closed) {
+        _state->wait(s, std::memory_order_acquire);
+        s = _state->load(std::memory_order_acquire);
+      }
+    }
+
+  private:
+
+    static constexpr uint64_t Closed = uint64_t{1} << 63;
+
+    // number of running tasks, plus Closed once the caller is done
+    std::shared_ptr<std::atomic<uint64_t>> _state = std::make_shared<std::atomic<uint64_t>>(0);
+};
+
+// run body(begin, end, k) on num_chunks contiguous chunks of [0, n).
+// the calling thread and the executor claim the chunks one by one, so the
+// calling thread runs all of them if no worker is free
+template <typename F>
+void for_each_chunk(tf::Executor& executor, size_t n, size_t num_chunks, F&& body) {
+  std::atomic<size_t> next = 0;
+  auto run = [n, num_chunks, &next, &body]() {
+    for(size_t k; (k = next.fetch_add(1, std::memory_order_relaxed)) < num_chunks; ) {
+      body(n * k / num_chunks, n * (k + 1) / num_chunks, k);
+    }
+  };
+  TaskJoin join;
+  for(size_t k=1; k<num_chunks; k++) {
+    join.async(executor, run);
+  }
+  run();
+  join.close();
+}
+
+// hash of the bytes of a file, the same for any number of workers:
+// 1 MiB blocks are hashed in parallel and combined in order
+uint64_t file_hash(std::string_view data, tf::Executor& executor) {
+  constexpr size_t BlockBytes = size_t{1} << 20;
+  const size_t num_blocks = (data.size() + BlockBytes - 1) / BlockBytes;
+  std::vector<uint64_t> block_hash(num_blocks);
+  size_t num_chunks = std::clamp<size_t>(num_blocks, 1, executor.num_workers());
+  for_each_chunk(executor, num_blocks, num_chunks, [&](size_t beg, size_t end, size_t) {
+    for(size_t b=beg; b<end; b++) {
+      std::string_view block = data.substr(b * BlockBytes, BlockBytes);
+      uint64_t h = 0;
+      size_t i = 0;
+      for(; i + 8 <= block.size(); i += 8) {
+        uint64_t word;
+        std::memcpy(&word, block.data() + i, 8);
+        h = mix64(h ^ word);
+      }
+      uint64_t tail = 0;
+      std::memcpy(&tail, block.data() + i, block.size() - i);
+      block_hash[b] = mix64(h ^ tail);
+    }
+  });
+  uint64_t h = data.size();
+  for(uint64_t bh : block_hash) {
+    h = mix64(h + bh);
+  }
+  return h;
+}
+
+// size an array of atomic counters to at least n and zero the first n
+void reset_counters(std::vector<std::atomic<size_t>>& counters, size_t n) {
+  if(counters.size() < n) {
+    std::vector<std::atomic<size_t>>(n).swap(counters);
+    return;
+  }
+  for(size_t i=0; i<n; i++) {
+    counters[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+// the multilevel partitioner coarsens until a level removes less than this fraction
+// of the nodes, or for at most this many levels
+constexpr double MultilevelMinShrink = 0.05;
+constexpr size_t MultilevelMaxLevels = 32;
+
+// boundary refinement sweeps over the nodes of every level at most this many times
+constexpr size_t MultilevelRefinePasses = 4;
+
+/*
+ * one level of the multilevel partitioner: a DAG over the coarse nodes of the level
+ * below, without holes or parallel edges. weights count the original edges behind
+ * every edge, cost and size the total cost and number of the original nodes behind
+ * every node
+ */
+struct CoarseGraph {
+  FrozenGraph graph;
+  std::vector<uint32_t> fanin_weights;  // parallel to graph.fanins
+  std::vector<uint32_t> fanout_weights; // parallel to graph.fanouts
+  std::vector<uint32_t> cost;
+  std::vector<uint32_t> size;
+};
+
+// contract the live nodes of g into num_coarse nodes by parent (indexed by the ids of g),
+// weights (parallel to g.fanouts) default to 1, edges inside a coarse node disappear
+// and parallel edges are merged
+void contract(const FrozenGraph& g, const std::vector<uint32_t>* weights, const std::vector<uint32_t>& cost,
+              const std::vector<uint32_t>* size, const std::vector<uint32_t>& parent, size_t num_coarse,
+              CoarseGraph& out) {
+
+  FrozenGraph& cg = out.graph;
+  cg.ids.resize(num_coarse);
+  std::iota(cg.ids.begin(), cg.ids.end(), 0);
+  cg.nodes.assign(num_coarse, nullptr);
+  out.cost.assign(num_coarse, 0);
+  out.size.assign(num_coarse, 0);
+
+  // bucket the edges between coarse nodes by their tail
+  cg.fanout_offsets.assign(num_coarse + 1, 0);
+  for(uint32_t v : g.ids) {
+    const uint32_t x = parent[v];
+    if(!cg.nodes[x]) {
+      cg.nodes[x] = g.nodes[v];
+    }
+    out.cost[x] = static_cast<uint32_t>(std::min<uint64_t>(
+      uint64_t{out.cost[x]} + cost[v], std::numeric_limits<uint32_t>::max()
+    ));
+    out.size[x] += size ? (*size)[v] : 1;
+    for(size_t e=g.fanout_offsets[v]; e<g.fanout_offsets[v+1]; e++) {
+      cg.fanout_offsets[x+1] += (parent[g.fanouts[e]] != x);
+    }
+  }
+  std::partial_sum(cg.fanout_offsets.begin(), cg.fanout_offsets.end(), cg.fanout_offsets.begin());
+
+  std::vector<std::pair<uint32_t, uint32_t>> edges(cg.fanout_offsets[num_coarse]); // (head, weight)
+  std::vector<size_t> cursor(cg.fanout_offsets.begin(), cg.fanout_offsets.end() - 1);
+  for(uint32_t v : g.ids) {
+    const uint32_t x = parent[v];
+    for(size_t e=g.fanout_offsets[v]; e<g.fanout_offsets[v+1]; e++) {
+      if(parent[g.fanouts[e]] != x) {
+        edges[cursor[x]++] = {parent[g.fanouts[e]], weights ? (*weights)[e] : 1};
+      }
+    }
+  }
+
+  // merge the parallel edges of every bucket
+  size_t num_edges = 0;
+  for(size_t x=0; x<num_coarse; x++) {
+    auto beg = edges.begin() + cg.fanout_offsets[x];
+    auto end = edges.begin() + cg.fanout_offsets[x+1];
+    std::sort(beg, end);
+    cg.fanout_offsets[x] = num_edges;
+    for(auto it=beg; it!=end; ++it) {
+      if(num_edges > cg.fanout_offsets[x] && edges[num_edges-1].first == it->first) {
+        edges[num_edges-1].second += it->second;
+      }
+      else {
+        edges[num_edges++] = *it;
+      }
+    }
+  }
+  cg.fanout_offsets[num_coarse] = num_edges;
+  cg.fanouts.resize(num_edges);
+  out.fanout_weights.resize(num_edges);
+  for(size_t e=0; e<num_edges; e++) {
+    cg.fanouts[e] = edges[e].first;
+    out.fanout_weights[e] = edges[e].second;
+  }
+
+  // fanins by transposing the fanouts
+  cg.fanin_offsets.assign(num_coarse + 1, 0);
+  for(uint32_t y : cg.fanouts) {
+    ++cg.fanin_offsets[y+1];
+  }
+  std::partial_sum(cg.fanin_offsets.begin(), cg.fanin_offsets.end(), cg.fanin_offsets.begin());
+  cg.fanins.resize(num_edges);
+  out.fanin_weights.resize(num_edges);
+  cursor.assign(cg.fanin_offsets.begin(), cg.fanin_offsets.end() - 1);
+  for(uint32_t x=0; x<num_coarse; x++) {
+    for(size_t e=cg.fanout_offsets[x]; e<cg.fanout_offsets[x+1]; e++) {
+      size_t i = cursor[cg.fanouts[e]]++;
+      cg.fanins[i] = x;
+      out.fanin_weights[i] = out.fanout_weights[e];
+    }
+  }
+}
+
+/*
+ * heavy-edge matching that keeps the contracted graph acyclic.
+ * an edge u -> v may be contracted only if v is the only fanout of u or u the only
+ * fanin of v: then every edge into the pair reaches every edge out of it through the
+ * pair, so a cycle among contracted pairs would come from a cycle of the graph.
+ * a node is matched with the unmatched neighbour behind its heaviest such edge whose
+ * cost fits the budget together with its own.
+ * writes parent and returns the number of coarse nodes
+ */
+size_t match_nodes(const CoarseGraph& level, size_t budget, std::vector<uint32_t>& parent) {
+
+  const FrozenGraph& g = level.graph;
+  const size_t n = g.num_nodes();
+  parent.assign(n, NoNode);
+
+  uint32_t num_coarse = 0;
+  for(uint32_t v=0; v<n; v++) {
+    if(parent[v] != NoNode) {
+      continue;
+    }
+    uint32_t best = NoNode;
+    uint32_t best_weight = 0;
+    auto consider = [&](uint32_t u, uint32_t weight, bool contractible) {
+      if(contractible && parent[u] == NoNode && weight > best_weight &&
+         uint64_t{level.cost[v]} + level.cost[u] <= budget) {
+        best = u;
+        best_weight = weight;
+      }
+    };
+    for(size_t e=g.fanout_offsets[v]; e<g.fanout_offsets[v+1]; e++) {
+      uint32_t u = g.fanouts[e];
+      consider(u, level.fanout_weights[e], g.num_fanouts(v) == 1 || g.num_fanins(u) == 1);
+    }
+    for(size_t e=g.fanin_offsets[v]; e<g.fanin_offsets[v+1]; e++) {
+      uint32_t u = g.fanins[e];
+      consider(u, level.fanin_weights[e], g.num_fanins(v) == 1 || g.num_fanouts(u) == 1);
+    }
+    parent[v] = num_coarse;
+    if(best != NoNode) {
+      parent[best] = num_coarse;
+    }
+    ++num_coarse;
+  }
+  return num_coarse;
+}
+
+/*
+ * boundary refinement of clusters whose ids never decrease along an edge, which keeps
+ * the cluster graph acyclic. a node can then only move to the cluster of its latest
+ * fanins or of its earliest fanouts, and it does if that cuts more edge weight than it
+ * adds, or as much while evening out the cost of the two clusters, within the budget
+ */
+void refine_clusters(const CoarseGraph& level, size_t budget, std::vector<int>& cluster_ids,
+                     std::vector<size_t>& cluster_cost) {
+
+  const FrozenGraph& g = level.graph;
+  const size_t n = g.num_nodes();
+
+  for(size_t pass=0; pass<MultilevelRefinePasses; pass++) {
+    size_t num_moves = 0;
+    for(uint32_t v=0; v<n; v++) {
+      const int cur = cluster_ids[v];
+      int lo = -1;
+      int hi = std::numeric_limits<int>::max();
+      for(size_t e=g.fanin_offsets[v]; e<g.fanin_offsets[v+1]; e++) {
+        lo = std::max(lo, cluster_ids[g.fanins[e]]);
+      }
+      for(size_t e=g.fanout_offsets[v]; e<g.fanout_offsets[v+1]; e++) {
+        hi = std::min(hi, cluster_ids[g.fanouts[e]]);
+      }
+      if(lo == cur && hi == cur) {
+        continue;
+      }
+      // edge weight to the current cluster and to both candidates
+      int64_t to_cur = 0, to_lo = 0, to_hi = 0;
+      for(size_t e=g.fanin_offsets[v]; e<g.fanin_offsets[v+1]; e++) {
+        int c = cluster_ids[g.fanins[e]];
+        to_cur += (c == cur) ? level.fanin_weights[e] : 0;
+        to_lo += (c == lo) ? level.fanin_weights[e] : 0;
+      }
+      for(size_t e=g.fanout_offsets[v]; e<g.fanout_offsets[v+1]; e++) {
+        int c = cluster_ids[g.fanouts[e]];
+        to_cur += (c == cur) ? level.fanout_weights[e] : 0;
+        to_hi += (c == hi) ? level.fanout_weights[e] : 0;
+      }
+      const uint32_t cost = level.cost[v];
+      auto better = [&](int target, int64_t gain) {
+        return target != cur && fits(cluster_cost[target], cost, budget) &&
+               (gain > 0 || (gain == 0 && cluster_cost[target] + cost < cluster_cost[cur]));
+      };
+      int target = cur;
+      int64_t best_gain = 0;
+      if(lo >= 0 && better(lo, to_lo - to_cur)) {
+        target = lo;
+        best_gain = to_lo - to_cur;
+      }
+      if(hi != std::numeric_limits<int>::max() && better(hi, to_hi - to_cur) &&
+         (target == cur || to_hi - to_cur > best_gain)) {
+        target = hi;
+      }
+      if(target != cur) {
+        cluster_cost[cur] -= cost;
+        cluster_cost[target] += cost;
+        cluster_ids[v] = target;
+        ++num_moves;
+      }
+    }
+    if(num_moves == 0) {
+      break;
+    }
+  }
+}
+
+} // end of anonymous namespace
+
 Graph::Graph(const std::string& filename) {
 
+  std::unique_ptr<MappedFile> file;
+  try {
+    file = std::make_unique<MappedFile>(filename);
+  }
+  catch(const std::runtime_error&) {
+    std::cerr << "Error opening file.\n";
+    std::exit(EXIT_FAILURE);
+  }
+
+  // files written by save_binary start with a magic number, everything else is text
+  std::string_view data = file->view();
+  if(data.substr(0, sizeof(BinaryMagic)) == std::string_view(BinaryMagic, sizeof(BinaryMagic))) {
+    try {
+      _load_binary(data);
+    }
+    catch(const std::runtime_error& e) {
+      std::cerr << "Error: " << e.what() << ".\n";
+      std::exit(EXIT_FAILURE);
+    }
+  }
+  else {
+    _load_text(data);
+  }
+}
+
+Graph::Graph(const std::string& filename, const std::vector<std::string>& roots,
+             ConeDirection direction, const std::string& index_file) {
+
+  std::unique_ptr<MappedFile> file;
+  try {
+    file = std::make_unique<MappedFile>(filename);
+  }
+  catch(const std::runtime_error&) {
+    std::cerr << "Error opening file.\n";
+    std::exit(EXIT_FAILURE);
+  }
+  std::string_view data = file->view();
+
+  // building the index takes every edge of the design, which is what cone loading avoids,
+  // so a missing or stale index is an error rather than rebuilt in memory
+  const std::string index_path = index_file.empty() ? filename + ".cone" : index_file;
+  std::unique_ptr<MappedFile> index_map;
+  std::string_view index;
+  try {
+    index_map = std::make_unique<MappedFile>(index_path);
+    index = index_map->view();
+  }
+  catch(const std::runtime_error&) {
+  }
+
+  try {
+    if(!cone_index_matches(index, data.size(), file_hash(data, _executor))) {
+      throw std::runtime_error("no cone index of " + filename + " in " + index_path +
+                               ", build one with Graph::build_cone_index");
+    }
+    _load_cone(data, index, roots, direction);
+  }
+  catch(const std::runtime_error& e) {
+    std::cerr << "Error: " << e.what() << ".\n";
+    std::exit(EXIT_FAILURE);
+  }
+}
+
+void Graph::build_cone_index(const std::string& filename, const std::string& index_file) {
+
+  MappedFile file(filename);
+  tf::Executor executor;
+  std::vector<char> index = make_cone_index(file.view(), file_hash(file.view(), executor));
+
+  std::ofstream out(index_file, std::ios::binary);
+  out.write(index.data(), index.size());
+  if(!out) {
+    throw std::runtime_error("cannot write " + index_file);
+  }
+}
+
+void Graph::_load_cone(std::string_view data, std::string_view index, const std::vector<std::string>& roots,
+                       ConeDirection direction) {
+
+  const ConeIndex ci = parse_cone_index(index);
+  auto name = [&data, &ci](uint32_t v) {
+    if(ci.name_offsets[v] + ci.name_lengths[v] > data.size()) {
+      throw std::runtime_error("cone index points past the end of the graph file");
+    }
+    return data.substr(ci.name_offsets[v], ci.name_lengths[v]);
+  };
+
+  // resolve the roots through the name table, every node of a repeated name is a root
+  std::vector<uint32_t> cone;
+  for(const auto& root : roots) {
+    const size_t num_found = cone.size();
+    uint64_t slot = fnv1a(root) & (ci.table_size - 1);
+    for(; ci.names[slot] != 0; slot = (slot + 1) & (ci.table_size - 1)) {
+      uint32_t v = ci.names[slot] - 1;
+      if(v >= ci.num_nodes) {
+        throw std::runtime_error("cone index node out of range");
+      }
+      if(ci.name_lengths[v] == root.size() && name(v) == root) {
+        cone.push_back(v);
+      }
+    }
+    if(cone.size() == num_found) {
+      throw std::runtime_error("unknown node \"" + root + "\"");
+    }
+  }
+  std::sort(cone.begin(), cone.end());
+  cone.erase(std::unique(cone.begin(), cone.end()), cone.end());
+
+  // walk the index to the side of the roots, the scratch state grows with the cone
+  const uint64_t* offsets = (direction == ConeDirection::Fanin) ? ci.fanin_offsets : ci.fanout_offsets;
+  const uint32_t* adj = (direction == ConeDirection::Fanin) ? ci.fanins : ci.fanouts;
+  std::unordered_set<uint32_t> in_cone(cone.begin(), cone.end());
+  for(size_t head=0; head<cone.size(); head++) {
+    uint32_t v = cone[head];
+    for(uint64_t e=offsets[v]; e<offsets[v+1]; e++) {
+      uint32_t u = adj[e];
+      if(u >= ci.num_nodes) {
+        throw std::runtime_error("cone index node out of range");
+      }
+      if(in_cone.insert(u).second) {
+        cone.push_back(u);
+      }
+    }
+  }
+
+  // materialize in file order
+  std::sort(cone.begin(), cone.end());
+  std::vector<Node*> nodes(cone.size());
+  _nodes.reserve(cone.size());
+  _store.reserve(cone.size());
+  for(size_t i=0; i<cone.size(); i++) {
+    nodes[i] = _insert_node(name(cone[i]), RunMode::None, 8);
+    if(ci.costs[cone[i]] == 0) {
+      throw std::runtime_error("node cost out of range");
+    }
+    _store.cost[nodes[i]->_id] = ci.costs[cone[i]];
+  }
+  for(size_t i=0; i<cone.size(); i++) {
+    uint32_t u = cone[i];
+    for(uint64_t e=ci.fanout_offsets[u]; e<ci.fanout_offsets[u+1]; e++) {
+      uint32_t v = ci.fanouts[e];
+      if(in_cone.count(v)) {
+        auto it = std::lower_bound(cone.begin(), cone.end(), v);
+        _insert_edge(nodes[i], nodes[it - cone.begin()], RunMode::None);
+      }
+    }
+  }
+}
+
+void Graph::_load_text(std::string_view text) {
+
   /*
     file format example:
     3
     "A";
-    "B";
+    "B" 4;
     "C";
     "A" -> "B";
     "B" -> "C";
+    (a number after a node name is its cost, 1 if omitted)
   */
 
-  std::ifstream infile(filename);
-  if(!infile) {
-    std::cerr << "Error opening file.\n";
-    std::exit(EXIT_FAILURE);
+  TextCursor in {text.data(), text.data() + text.size()};
+
+  // read the number of nodes
+  size_t num_nodes;
+  if(!in.number(num_nodes)) {
+    std::cerr << "Error: missing number of nodes.\n";
+    std::exit(EXIT_FAILURE);
+  }
+
+  // read node names and add them to the graph
+  // names are views into the mapped file and copied once into the name table
+  _nodes.reserve(num_nodes);
+  _store.reserve(num_nodes);
+  std::string_view node_name;
+  uint32_t cost;
+  for(size_t i=0; i<num_nodes; i++) {
+    if(!in.declaration(node_name, cost)) {
+      std::cerr << "Error: malformed node declaration " << i << ".\n";
+      std::exit(EXIT_FAILURE);
+    }
+    _store.cost[_insert_node(node_name, RunMode::None, 8)->_id] = cost;
+  }
+
+  // read edges and add them to the graph
+  // the edge section is split at line breaks into chunks that are tokenized
+  // and resolved through the name index in parallel, then inserted in file order
+  const char* beg = in.cur;
+  const char* end = in.end;
+  size_t num_chunks = std::clamp<size_t>(static_cast<size_t>(end - beg) / (64 * 1024), 1,
+                                         std::max<size_t>(1, _executor.num_workers()));
+
+  std::vector<std::vector<std::pair<uint32_t, uint32_t>>> edges;
+  std::vector<std::string> errors;
+
+  auto parse = [&](size_t num) {
+    std::vector<const char*> bounds(num + 1, end);
+    bounds[0] = beg;
+    for(size_t k=1; k<num; k++) {
+      const char* p = std::max(bounds[k-1], beg + (end - beg) * k / num);
+      const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+      bounds[k] = nl ? nl + 1 : end;
+    }
+    edges.assign(num, {});
+    errors.assign(num, {});
+    auto parse_chunk = [&](size_t k) {
+      TextCursor c {bounds[k], bounds[k+1]};
+      std::string_view from, to;
+      while(!c.eof()) {
+        if(!c.quoted(from) || !c.literal("->") || !c.quoted(to) || !c.literal(";")) {
+          errors[k] = "malformed edge";
+          return;
+        }
+        uint32_t u = _store.name.find(from);
+        uint32_t v = _store.name.find(to);
+        if(u >= _store.size() || v >= _store.size()) {
+          errors[k] = "edge \"" + std::string(from) + "\" -> \"" + std::string(to) + 
+                      "\" refers to an undeclared node";
+          return;
+        }
+        edges[k].emplace_back(u, v);
+      }
+    };
+    for_each_chunk(_executor, num, num, [&](size_t, size_t, size_t k) {
+      parse_chunk(k);
+    });
+  };
+
+  parse(num_chunks);
+  // an edge written across a line break can be cut by the chunking, retry sequentially
+  if(num_chunks > 1 && std::any_of(errors.begin(), errors.end(), [](auto& e){ return !e.empty(); })) {
+    parse(1);
+  }
+  for(const auto& error : errors) {
+    if(!error.empty()) {
+      std::cerr << "Error: " << error << ".\n";
+      std::exit(EXIT_FAILURE);
+    }
+  }
+
+  size_t num_edges = 0;
+  for(const auto& chunk : edges) {
+    num_edges += chunk.size();
+  }
+  _edges.reserve(num_edges);
+  for(const auto& chunk : edges) {
+    for(auto [u, v] : chunk) {
+      _insert_edge(_store.node[u], _store.node[v], RunMode::None);
+    }
+  }
+}
+
+void Graph::save_binary(const std::string& path) const {
+
+  // position of each node in _nodes is its number in the file
+  std::vector<uint32_t> index(_store.size());
+  for(size_t i=0; i<_nodes.size(); i++) {
+    index[_nodes[i]->_id] = static_cast<uint32_t>(i);
+  }
+
+  std::vector<char> names;
+  std::vector<char> edges;
+  std::vector<char> costs;
+  bool has_costs = false;
+  for(auto node : _nodes) {
+    std::string_view name = _store.name[node->_id];
+    put_varint(names, name.size());
+    names.insert(names.end(), name.begin(), name.end());
+
+    put_varint(costs, _store.cost[node->_id]);
+    has_costs |= (_store.cost[node->_id] != 1);
+
+    const EdgeList& fanouts = _store.fanouts[node->_id];
+    put_varint(edges, fanouts.size());
+    int64_t prev = index[node->_id];
+    for(auto edge : fanouts) {
+      int64_t to = index[edge->_to->_id];
+      put_varint(edges, zigzag(to - prev));
+      prev = to;
+    }
+  }
+
+  BinaryHeader header;
+  std::memcpy(header.magic, BinaryMagic, sizeof(BinaryMagic));
+  header.version = BinaryVersion;
+  header.flags = has_costs ? BinaryCosts : 0;
+  header.num_nodes = _nodes.size();
+  header.num_edges = _edges.size();
+  header.names_bytes = names.size();
+  header.edges_bytes = edges.size();
+
+  std::ofstream out(path, std::ios::binary);
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(names.data(), names.size());
+  out.write(edges.data(), edges.size());
+  if(has_costs) {
+    out.write(costs.data(), costs.size());
+  }
+  if(!out) {
+    throw std::runtime_error("cannot write " + path);
+  }
+}
+
+void Graph::load_binary(const std::string& path) {
+  MappedFile file(path);
+  _load_binary(file.view());
+}
+
+void Graph::_load_binary(std::string_view data) {
+
+  if(!_nodes.empty()) {
+    throw std::runtime_error("load_binary: graph is not empty");
+  }
+
+  BinaryHeader header;
+  if(data.size() < sizeof(header)) {
+    throw std::runtime_error("truncated binary graph header");
+  }
+  std::memcpy(&header, data.data(), sizeof(header));
+  if(std::memcmp(header.magic, BinaryMagic, sizeof(BinaryMagic)) != 0) {
+    throw std::runtime_error("not a binary graph file");
+  }
+  if(header.version != BinaryVersion) {
+    throw std::runtime_error("unsupported binary graph version " + std::to_string(header.version));
+  }
+  if((header.flags & ~BinaryCosts) != 0) {
+    throw std::runtime_error("unsupported binary graph flags");
+  }
+  // the cost section has no size of its own, it runs to the end of the file
+  const size_t size = sizeof(header) + header.names_bytes + header.edges_bytes;
+  if((header.flags & BinaryCosts) ? size >= data.size() : size != data.size()) {
+    throw std::runtime_error("binary graph size does not match its header");
+  }
+
+  const char* p = data.data() + sizeof(header);
+  const char* names_end = p + header.names_bytes;
+  const char* edges_end = names_end + header.edges_bytes;
+  const char* costs_end = data.data() + data.size();
+
+  try {
+    std::vector<Node*> nodes(header.num_nodes);
+    _nodes.reserve(header.num_nodes);
+    _store.reserve(header.num_nodes);
+    for(size_t i=0; i<header.num_nodes; i++) {
+      nodes[i] = _insert_node(get_name(p, names_end), RunMode::None, 8);
+    }
+
+    _edges.reserve(header.num_edges);
+    p = names_end;
+    const int64_t n = static_cast<int64_t>(header.num_nodes);
+    for(int64_t v=0; v<n; v++) {
+      uint64_t degree = get_varint(p, edges_end);
+      int64_t prev = v;
+      for(uint64_t k=0; k<degree; k++) {
+        int64_t to = prev + unzigzag(get_varint(p, edges_end));
+        if(to < 0 || to >= n) {
+          throw std::runtime_error("edge target out of range");
+        }
+        _insert_edge(nodes[v], nodes[to], RunMode::None);
+        prev = to;
+      }
+    }
+    if(p != edges_end || _edges.size() != header.num_edges) {
+      throw std::runtime_error("binary graph edge count does not match its header");
+    }
+
+    if(header.flags & BinaryCosts) {
+      for(auto node : nodes) {
+        uint64_t cost = get_varint(p, costs_end);
+        if(cost == 0 || cost > std::numeric_limits<uint32_t>::max()) {
+          throw std::runtime_error("node cost out of range");
+        }
+        _store.cost[node->_id] = static_cast<uint32_t>(cost);
+      }
+      if(p != costs_end) {
+        throw std::runtime_error("binary graph cost section does not match its header");
+      }
+    }
+  }
+  catch(...) {
+    // leave an empty graph behind
+    while(!_nodes.empty()) {
+      _remove_node(_nodes.back(), RunMode::None);
+    }
+    throw;
+  }
+}
+
+uint64_t Graph::content_hash() const {
+
+  std::vector<uint64_t> name_hash(_store.size());
+  for(auto node : _nodes) {
+    name_hash[node->_id] = fnv1a(_store.name[node->_id]);
+  }
+
+  // sum of per-node and per-edge terms, so neither the order of _nodes/_edges
+  // nor the ids matter; the edge term is asymmetric in (from, to).
+  // a node of the default cost 1 adds the same term as before costs existed
+  uint64_t h = 0;
+  for(auto node : _nodes) {
+    uint32_t cost = _store.cost[node->_id];
+    h += mix64(name_hash[node->_id] ^ (cost == 1 ? 0 : mix64(cost)));
+  }
+  for(auto edge : _edges) {
+    h += mix64(name_hash[edge->_from->_id] ^ mix64(name_hash[edge->_to->_id] + 0x9e3779b97f4a7c15ULL));
+  }
+  return mix64(h + _nodes.size() * 0x9e3779b97f4a7c15ULL + _edges.size());
+}
+
+void Graph::save_partition(const std::string& path) const {
+
+  // position of each node in _nodes is its number in the file
+  std::vector<uint32_t> index(_store.size());
+  for(size_t i=0; i<_nodes.size(); i++) {
+    index[_nodes[i]->_id] = static_cast<uint32_t>(i);
+  }
+
+  // incremental C-PASTA orders clusters by rank instead of by id,
+  // save them renumbered in that order so ids are nondecreasing along edges again
+  std::vector<int> cluster_ids(_max_cluster_id + 1);
+  std::iota(cluster_ids.begin(), cluster_ids.end(), 0);
+  int max_cluster_id = _max_cluster_id;
+  if(_cpasta_tracking) {
+    max_cluster_id = -1;
+    for(auto [rank, c] : _cluster_order) {
+      cluster_ids[c] = ++max_cluster_id;
+    }
+  }
+
+  uint32_t flags = 0;
+  if(_max_cluster_id >= 0) {
+    flags |= PartitionCPasta;
+  }
+  if(_num_streams > 0) {
+    flags |= PartitionStreams;
+    if(_incremental_streams) {
+      flags |= PartitionIncremental;
+    }
+  }
+
+  std::vector<char> names;
+  std::vector<char> body;
+  for(auto node : _nodes) {
+    std::string_view name = _store.name[node->_id];
+    put_varint(names, name.size());
+    names.insert(names.end(), name.begin(), name.end());
+
+    if(flags & PartitionCPasta) {
+      int cluster_id = _store.cluster_id[node->_id];
+      put_varint(body, zigzag(cluster_id < 0 ? -1 : cluster_ids[cluster_id]));
+    }
+    if(flags & PartitionStreams) {
+      put_varint(body, zigzag(_store.lid[node->_id]));
+      put_varint(body, node->_reconstructed_fanouts.size());
+      for(auto fanout : node->_reconstructed_fanouts) {
+        put_varint(body, index[fanout->_id]);
+      }
+      put_varint(body, node->_extra_fanout ? index[node->_extra_fanout->_id] + 1 : 0);
+    }
+  }
+
+  PartitionHeader header;
+  std::memcpy(header.magic, PartitionMagic, sizeof(PartitionMagic));
+  header.version = PartitionVersion;
+  header.flags = flags;
+  header.graph_hash = content_hash();
+  header.partition_size = _partition_size;
+  header.num_streams = _num_streams;
+  header.num_nodes = _nodes.size();
+  header.max_cluster_id = max_cluster_id;
+  header.names_bytes = names.size();
+  header.body_bytes = body.size();
+
+  std::ofstream out(path, std::ios::binary);
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(names.data(), names.size());
+  out.write(body.data(), body.size());
+  if(!out) {
+    throw std::runtime_error("cannot write " + path);
+  }
+}
+
+bool Graph::load_partition(const std::string& path) {
+
+  std::unique_ptr<MappedFile> file;
+  try {
+    file = std::make_unique<MappedFile>(path);
+  }
+  catch(const std::runtime_error&) {
+    return false;
+  }
+  std::string_view data = file->view();
+
+  PartitionHeader header;
+  if(data.size() < sizeof(header)) {
+    throw std::runtime_error("truncated partition header");
+  }
+  std::memcpy(&header, data.data(), sizeof(header));
+  if(std::memcmp(header.magic, PartitionMagic, sizeof(PartitionMagic)) != 0) {
+    throw std::runtime_error("not a partition file");
+  }
+  if(header.version != PartitionVersion) {
+    throw std::runtime_error("unsupported partition version " + std::to_string(header.version));
+  }
+  if(sizeof(header) + header.names_bytes + header.body_bytes != data.size()) {
+    throw std::runtime_error("partition size does not match its header");
+  }
+  if((header.flags & PartitionStreams) && header.num_streams == 0) {
+    throw std::runtime_error("partition has streams but num_streams is 0");
+  }
+
+  // the partition size is part of the key, an unset one is taken from the file
+  const bool has_clusters = header.flags & PartitionCPasta;
+  const bool has_streams = header.flags & PartitionStreams;
+  if(has_clusters && _partition_size != 0 && _partition_size != header.partition_size) {
+    return false;
+  }
+
+  const char* p = data.data() + sizeof(header);
+  const char* names_end = p + header.names_bytes;
+  const char* body_end = names_end + header.body_bytes;
+  const size_t n = header.num_nodes;
+
+  // match the saved nodes to the current ones by name;
+  // unnamed nodes and repeated names are left unmatched (nullptr)
+  std::vector<Node*> nodes(n, nullptr);
+  std::vector<char> matched(_store.size(), 0);
+  size_t num_matched = 0;
+  for(size_t i=0; i<n; i++) {
+    Node* node = _find_node(get_name(p, names_end));
+    if(node && !matched[node->_id]) {
+      matched[node->_id] = 1;
+      nodes[i] = node;
+      ++num_matched;
+    }
+  }
+  if(p != names_end) {
+    throw std::runtime_error("partition node names do not match its header");
+  }
+
+  // decode the whole body before touching the graph
+  std::vector<int> saved_cluster_ids;
+  std::vector<int> saved_lids;
+  std::vector<size_t> fanout_offsets;
+  std::vector<uint32_t> fanouts;
+  std::vector<uint64_t> extra_fanouts;
+  if(has_clusters) {
+    saved_cluster_ids.resize(n);
+  }
+  if(has_streams) {
+    saved_lids.resize(n);
+    fanout_offsets.resize(n + 1, 0);
+    extra_fanouts.resize(n);
+  }
+  for(size_t i=0; i<n; i++) {
+    if(has_clusters) {
+      int64_t cluster_id = unzigzag(get_varint(p, body_end));
+      if(cluster_id < -1 || cluster_id > header.max_cluster_id) {
+        throw std::runtime_error("cluster id out of range");
+      }
+      saved_cluster_ids[i] = static_cast<int>(cluster_id);
+    }
+    if(has_streams) {
+      saved_lids[i] = static_cast<int>(unzigzag(get_varint(p, body_end)));
+      uint64_t degree = get_varint(p, body_end);
+      for(uint64_t k=0; k<degree; k++) {
+        uint64_t to = get_varint(p, body_end);
+        if(to >= n) {
+          throw std::runtime_error("reconstructed fanout out of range");
+        }
+        fanouts.push_back(static_cast<uint32_t>(to));
+      }
+      fanout_offsets[i+1] = fanouts.size();
+      extra_fanouts[i] = get_varint(p, body_end);
+      if(extra_fanouts[i] > n) {
+        throw std::runtime_error("extra fanout out of range");
+      }
+    }
+  }
+  if(p != body_end) {
+    throw std::runtime_error("partition body does not match its header");
+  }
+
+  // unchanged graph: restore as is; otherwise repair around the edits
+  const bool unchanged = (header.graph_hash == content_hash() &&
+                          num_matched == n && n == _nodes.size());
+
+  if(has_clusters) {
+    std::vector<int> cluster_ids(_store.size(), -1);
+    for(size_t i=0; i<n; i++) {
+      if(nodes[i]) {
+        cluster_ids[nodes[i]->_id] = saved_cluster_ids[i];
+      }
+    }
+    _partition_size = header.partition_size;
+    // nodes inserted after the saved partition was computed have no cluster yet
+    if(unchanged && std::find(saved_cluster_ids.begin(), saved_cluster_ids.end(), -1) == saved_cluster_ids.end()) {
+      _max_cluster_id = static_cast<int>(header.max_cluster_id);
+    }
+    else {
+      _repair_cluster_ids(cluster_ids);
+    }
+    _store.cluster_id.swap(cluster_ids);
+    if(_max_cluster_id >= 0) {
+      _build_partitioned_graph();
+    }
+  }
+
+  if(has_streams) {
+    const bool incremental = header.flags & PartitionIncremental;
+    if(!unchanged) {
+      // the streams are assigned level by level, so an edit can move every node after it
+      if(incremental) {
+        partition_cudaflow_incremental(header.num_streams);
+      }
+      else {
+        partition_cudaflow(header.num_streams);
+      }
+    }
+    else {
+      for(auto node : _nodes) {
+        node->_reconstructed_fanins.clear();
+        node->_reconstructed_fanouts.clear();
+        node->_extra_fanin = nullptr;
+        node->_extra_fanout = nullptr;
+      }
+      for(size_t i=0; i<n; i++) {
+        Node* node = nodes[i];
+        _store.lid[node->_id] = saved_lids[i];
+        for(size_t k=fanout_offsets[i]; k<fanout_offsets[i+1]; k++) {
+          node->_reconstructed_fanouts.push_back(nodes[fanouts[k]]);
+          nodes[fanouts[k]]->_reconstructed_fanins.push_back(node);
+        }
+        if(extra_fanouts[i] != 0) {
+          node->_extra_fanout = nodes[extra_fanouts[i] - 1];
+          node->_extra_fanout->_extra_fanin = node;
+        }
+      }
+      _num_streams = header.num_streams;
+      _incremental_streams = incremental;
+    }
+  }
+
+  return true;
+}
+
+NodeId Graph::insert_node(const std::string& name, RunMode mode, size_t matrix_size) {
+  return _handle(_insert_node(name, mode, matrix_size));
+}
+
+EdgeId Graph::insert_edge(NodeId from, NodeId to, RunMode mode) {
+  return _handle(_insert_edge(_node(from), _node(to), mode));
+}
+
+void Graph::remove_node(NodeId node, RunMode mode) {
+  _remove_node(_node(node), mode);
+}
+
+void Graph::remove_edge(EdgeId edge, RunMode mode) {
+  Edge* edge_ptr = _edge_pool.at(edge.index, edge.generation);
+  if(!edge_ptr) {
+    throw std::runtime_error("remove_edge: stale edge handle");
+  }
+  _remove_edge(edge_ptr, mode);
+}
+
+bool Graph::contains(NodeId id) const {
+  return _node_pool.at(id.index, id.generation) != nullptr;
+}
+
+bool Graph::contains(EdgeId id) const {
+  return _edge_pool.at(id.index, id.generation) != nullptr;
+}
+
+std::string_view Graph::name(NodeId id) const {
+  return _store.name[_node(id)->_id];
+}
+
+size_t Graph::num_fanins(NodeId id) const {
+  return _store.fanins[_node(id)->_id].size();
+}
+
+size_t Graph::num_fanouts(NodeId id) const {
+  return _store.fanouts[_node(id)->_id].size();
+}
+
+void Graph::set_cost(NodeId id, uint32_t cost) {
+
+  if(cost == 0) {
+    throw std::runtime_error("node cost must be positive");
+  }
+  Node* node = _node(id);
+  const uint32_t old_cost = _store.cost[node->_id];
+  _store.cost[node->_id] = cost;
+  _chains_valid = false;
+
+  // a tracked cluster pushed over its budget gives the node up,
+  // the next incremental partition places it again
+  int cluster_id = _store.cluster_id[node->_id];
+  if(_cpasta_tracking && cluster_id >= 0) {
+    _cluster_cost[cluster_id] = _cluster_cost[cluster_id] - old_cost + cost;
+    if(_cnodes[cluster_id]->_nodes.size() > 1 && _cluster_cost[cluster_id] > _partition_size) {
+      _move_to_cluster(node, -1);
+      _cpasta_dirty.push_back(id);
+    }
+  }
+}
+
+uint32_t Graph::cost(NodeId id) const {
+  return _store.cost[_node(id)->_id];
+}
+
+int Graph::cluster_of(NodeId id) const {
+  return _store.cluster_id[_node(id)->_id];
+}
+
+void Graph::enable_edge_index(bool enable) {
+  _edge_index.clear();
+  _edge_index_enabled = enable;
+  if(enable) {
+    // with parallel edges already in the graph, the first one in _edges is indexed
+    _edge_index.reserve(_edges.size());
+    for(Edge* edge : _edges) {
+      _edge_index.insert(edge->_from->_id, edge->_to->_id, edge);
+    }
+  }
+}
+
+EdgeId Graph::find_edge(NodeId from, NodeId to) const {
+  Edge* edge = _find_edge(_node(from), _node(to));
+  return edge ? _handle(edge) : EdgeId{};
+}
+
+NodeId Graph::find_node(std::string_view name) const {
+  Node* node = _find_node(name);
+  return node ? _handle(node) : NodeId{};
+}
+
+Node* Graph::_find_node(std::string_view name) const {
+  uint32_t id = _store.name.find(name);
+  return id < _store.size() ? _store.node[id] : nullptr;
+}
+
+Edge* Graph::_find_edge(Node* from, Node* to) const {
+  if(_edge_index_enabled) {
+    return _edge_index.find(from->_id, to->_id);
+  }
+  for(Edge* edge : _store.fanouts[from->_id]) {
+    if(edge->_to == to) {
+      return edge;
+    }
+  }
+  return nullptr;
+}
+
+Node* Graph::_node(NodeId id) const {
+  Node* node_ptr = _node_pool.at(id.index, id.generation);
+  if(!node_ptr) {
+    throw std::runtime_error("stale node handle");
+  }
+  return node_ptr;
+}
+
+Node* Graph::_insert_node(std::string_view name, RunMode mode, size_t matrix_size) {
+
+  // Node node(name);
+  Node* node_ptr = _node_pool.allocate();
+  node_ptr->_node_satellite = _nodes.size();
+  _nodes.push_back(node_ptr);
+  node_ptr->_id = static_cast<int>(_store.acquire(node_ptr));
+  _store.name.set(node_ptr->_id, name);
+  ++_num_node_edits;
+  _frozen_valid = false;
+  _chains_valid = false;
+  _num_streams = 0;
+  if(_cpasta_tracking) {
+    _cpasta_dirty.push_back(_handle(node_ptr));
+  }
+
+  auto start_construct = std::chrono::steady_clock::now();
+  // if run taskflow with semaphore or incremental partition
+  if(mode == RunMode::Semaphore || mode == RunMode::IncrementalPartition) {
+    _emplace_task(node_ptr, mode, matrix_size);
+  }
+  auto end_construct = std::chrono::steady_clock::now();
+  size_t taskflow_constucttime = std::chrono::duration_cast<std::chrono::microseconds>(end_construct-start_construct).count();
+  // we won't run semaphore and partitioning in the same program so I just add them both
+  _incre_runtime_with_semaphore_graph_construct += taskflow_constucttime;
+  _incre_construct_runtime_with_cudaflow += taskflow_constucttime;
+
+  return node_ptr;
+}
+
+void Graph::_emplace_task(Node* node, RunMode mode, size_t matrix_size) {
+  tf::Task& task = _store.task[node->_id];
+  task = _taskflow.emplace([this, matrix_size, node]() {
+    run_task(matrix_size, _store.cost[node->_id]);
+  });
+  if(mode == RunMode::Semaphore) {
+    task.acquire(_semaphore);
+    task.release(_semaphore);
+  }
+}
+
+Edge* Graph::_insert_edge(Node* from, Node* to, RunMode mode) {
+
+  // reject parallel edges when the edge index is on
+  if(_edge_index_enabled) {
+    if(Edge* existing = _edge_index.find(from->_id, to->_id)) {
+      return existing;
+    }
+  }
+
+  // Edge edge;
+  Edge* edge_ptr = _edge_pool.allocate();
+
+  edge_ptr->_from = from;
+  edge_ptr->_to = to;
+
+  // tells the position of this edge in fanouts of from nodes and fanins of to nodes
+  // for remove_edge() and remove_node()
+  EdgeList& fanouts = _store.fanouts[from->_id];
+  EdgeList& fanins = _store.fanins[to->_id];
+  edge_ptr->_from_pos = fanouts.size();
+  edge_ptr->_to_pos = fanins.size();
+  fanouts.push_back(edge_ptr);
+  fanins.push_back(edge_ptr);
+
+  edge_ptr->_satellite = _edges.size();
+  _edges.push_back(edge_ptr);
+  if(_edge_index_enabled) {
+    _edge_index.insert(from->_id, to->_id, edge_ptr);
+  }
+  _frozen_valid = false;
+  _chains_valid = false;
+  _num_streams = 0;
+  if(_cpasta_tracking) {
+    // an edge into an earlier cluster reorders the clusters, or if they would
+    // form a cycle, moves its head at the next incremental partition
+    int from_cluster = _store.cluster_id[from->_id];
+    int to_cluster = _store.cluster_id[to->_id];
+    _count_cedge(from_cluster, to_cluster, true);
+    if(from_cluster >= 0 && to_cluster >= 0 && _cluster_rank[from_cluster] > _cluster_rank[to_cluster]) {
+      if(!_cpasta_ordered || !_reorder_clusters(from_cluster, to_cluster)) {
+        _cpasta_ordered = false;
+        _cpasta_dirty.push_back(_handle(to));
+      }
+    }
+  }
+
+  auto start_construct = std::chrono::steady_clock::now();
+  // if run taskflow with semaphore
+  if(mode == RunMode::Semaphore || mode == RunMode::IncrementalPartition) {
+    _store.task[from->_id].precede(_store.task[to->_id]);
+  }
+  auto end_construct = std::chrono::steady_clock::now();
+  size_t taskflow_constucttime = std::chrono::duration_cast<std::chrono::microseconds>(end_construct-start_construct).count();
+  _incre_runtime_with_semaphore_graph_construct += taskflow_constucttime;
+  _incre_construct_runtime_with_cudaflow += taskflow_constucttime;
+
+  return edge_ptr;
+}
+
+void Graph::_remove_node(Node* node, RunMode mode) {
+
+  // remove its fanin/fanout edges from _edges
+  // _remove_edge will erase this edge from the fanins/fanouts, so no need to pop_back()
+  // taking the last edge each time avoids swapping entries around
+  EdgeList& fanins = _store.fanins[node->_id];
+  EdgeList& fanouts = _store.fanouts[node->_id];
+  while(!fanins.empty()) {
+    Edge* from = fanins.back();
+    _remove_edge(from, RunMode::None);
+  }
+  while(!fanouts.empty()) {
+    Edge* to = fanouts.back();
+    _remove_edge(to, RunMode::None);
+  }
+  
+  auto start_construct = std::chrono::steady_clock::now();
+  // if run taskflow with semaphore
+  if(mode == RunMode::Semaphore || mode == RunMode::IncrementalPartition) {
+    _taskflow.erase(_store.task[node->_id]);
+  }
+  auto end_construct = std::chrono::steady_clock::now();
+  size_t taskflow_constucttime = std::chrono::duration_cast<std::chrono::microseconds>(end_construct-start_construct).count();
+  _incre_runtime_with_semaphore_graph_construct += taskflow_constucttime;
+  _incre_construct_runtime_with_cudaflow += taskflow_constucttime;
+
+  // leave its cluster, all of its edges are gone by now
+  if(_cpasta_tracking) {
+    _move_to_cluster(node, -1);
+  }
+
+  // move the last node into the hole and recycle the slot
+  Node* last = _nodes.back();
+  _nodes[node->_node_satellite] = last;
+  last->_node_satellite = node->_node_satellite;
+  _nodes.pop_back();
+  _store.release(node->_id);
+  _node_pool.deallocate(node);
+  ++_num_node_edits;
+  _frozen_valid = false;
+  _chains_valid = false;
+  _num_streams = 0;
+}
+
+void Graph::_remove_edge(Edge* edge, RunMode mode) {
+
+  Node* from = edge->_from;
+  Node* to = edge->_to;
+
+  if(_cpasta_tracking) {
+    _count_cedge(_store.cluster_id[from->_id], _store.cluster_id[to->_id], false);
+  }
+
+  // remove edge from fanouts of from node and fanins of to node
+  // swap the last entry into its position and patch the position of the moved edge
+  EdgeList& fanouts = _store.fanouts[from->_id];
+  Edge* moved = fanouts.back();
+  fanouts[edge->_from_pos] = moved;
+  moved->_from_pos = edge->_from_pos;
+  fanouts.pop_back();
+
+  EdgeList& fanins = _store.fanins[to->_id];
+  moved = fanins.back();
+  fanins[edge->_to_pos] = moved;
+  moved->_to_pos = edge->_to_pos;
+  fanins.pop_back();
+
+  if(_edge_index_enabled && _edge_index.find(from->_id, to->_id) == edge) {
+    _edge_index.erase(from->_id, to->_id);
+    // a parallel edge inserted before the index was enabled takes over the entry
+    for(Edge* e : fanouts) {
+      if(e->_to == to) {
+        _edge_index.insert(from->_id, to->_id, e);
+        break;
+      }
+    }
+  }
+
+  auto start_construct = std::chrono::steady_clock::now();
+  // if run taskflow with semaphore
+  if(mode == RunMode::Semaphore || mode == RunMode::IncrementalPartition) {
+    _store.task[from->_id].remove_successors(_store.task[to->_id]);
+    _store.task[to->_id].remove_predecessors(_store.task[from->_id]);
+  }
+  auto end_construct = std::chrono::steady_clock::now();
+  size_t taskflow_constucttime = std::chrono::duration_cast<std::chrono::microseconds>(end_construct-start_construct).count();
+  _incre_runtime_with_semaphore_graph_construct += taskflow_constucttime;
+  _incre_construct_runtime_with_cudaflow += taskflow_constucttime;
+
+  // move the last edge into the hole and recycle the slot
+  Edge* last = _edges.back();
+  _edges[edge->_satellite] = last;
+  last->_satellite = edge->_satellite;
+  _edges.pop_back();
+  _edge_pool.deallocate(edge);
+  _frozen_valid = false;
+  _chains_valid = false;
+  _num_streams = 0;
+}
+
+std::vector<NodeId> Graph::apply(const GraphDelta& delta, RunMode mode, size_t matrix_size) {
+  return _apply(delta, mode, matrix_size, true);
+}
+
+size_t Graph::replay(const std::string& changelog, RunMode mode, size_t matrix_size,
+                     const std::function<void(size_t)>& on_batch) {
+
+  ChangelogReader reader(changelog);
+  ChangeBatch batch;
+  GraphDelta delta;
+  std::unordered_map<std::string_view, GraphDelta::NodeRef> inserted; // names inserted by the batch
+
+  auto fail = [&reader](const std::string& what) {
+    throw std::runtime_error("changelog batch " + std::to_string(reader.num_batches() - 1) + ": " + what);
+  };
+  auto existing = [this, &fail](std::string_view name) {
+    Node* node = _find_node(name);
+    if(!node) {
+      fail("unknown node \"" + std::string(name) + "\"");
+    }
+    return node;
+  };
+  auto endpoint = [this, &inserted, &existing](std::string_view name) {
+    auto it = inserted.find(name);
+    return it != inserted.end() ? it->second : GraphDelta::NodeRef(_handle(existing(name)));
+  };
+
+  while(reader.next(batch)) {
+    delta.clear();
+    inserted.clear();
+    for(auto [from, to] : batch.remove_edges) {
+      Edge* edge = _find_edge(existing(from), existing(to));
+      if(!edge) {
+        fail("no edge \"" + std::string(from) + "\" -> \"" + std::string(to) + "\"");
+      }
+      delta.remove_edge(_handle(edge));
+    }
+    for(auto name : batch.remove_nodes) {
+      delta.remove_node(_handle(existing(name)));
+    }
+    for(auto name : batch.insert_nodes) {
+      inserted.insert_or_assign(name, delta.add_node(std::string(name)));
+    }
+    for(auto [from, to] : batch.insert_edges) {
+      delta.add_edge(endpoint(from), endpoint(to));
+    }
+    try {
+      _apply(delta, mode, matrix_size, true);
+    }
+    catch(const std::runtime_error& e) {
+      fail(e.what());
+    }
+    if(on_batch) {
+      on_batch(reader.num_batches() - 1);
+    }
+  }
+
+  return reader.num_batches();
+}
+
+std::vector<NodeId> Graph::_apply(const GraphDelta& delta, RunMode mode, size_t matrix_size, bool check_cycle) {
+
+  // 1) resolve and validate the whole batch before touching the graph
+  std::vector<Edge*> removed_edges;
+  removed_edges.reserve(delta.remove_edges.size());
+  for(EdgeId id : delta.remove_edges) {
+    Edge* edge = _edge_pool.at(id.index, id.generation);
+    if(!edge) {
+      throw std::runtime_error("apply: stale edge handle");
+    }
+    removed_edges.push_back(edge);
+  }
+  std::vector<Node*> removed_nodes;
+  removed_nodes.reserve(delta.remove_nodes.size());
+  for(NodeId id : delta.remove_nodes) {
+    removed_nodes.push_back(_node(id));
+  }
+
+  // a handle may be listed twice: drop the repeats but keep the given order,
+  // since the removal order decides where swap-remove moves the remaining nodes/edges
+  // (sorting by address would make the result depend on the heap layout)
+  auto dedup = [](auto& items, auto& seen) {
+    size_t n = 0;
+    for(auto item : items) {
+      if(seen.insert(item).second) {
+        items[n++] = item;
+      }
+    }
+    items.resize(n);
+  };
+  std::unordered_set<Edge*> seen_edges;
+  std::unordered_set<Node*> removed_node_set;
+  dedup(removed_edges, seen_edges);
+  dedup(removed_nodes, removed_node_set);
+
+  // endpoints of new edges are keyed by node id, new nodes get the keys after the id space
+  const uint32_t num_ids = static_cast<uint32_t>(_store.size());
+  auto key_of = [&](const GraphDelta::NodeRef& ref) -> uint32_t {
+    if(ref.is_new()) {
+      if(ref.pending >= delta.insert_nodes.size()) {
+        throw std::runtime_error("apply: edge refers to an unknown new node");
+      }
+      return num_ids + static_cast<uint32_t>(ref.pending);
+    }
+    Node* node = _node(ref.id);
+    if(removed_node_set.count(node)) {
+      throw std::runtime_error("apply: edge refers to a node removed in the same batch");
+    }
+    return static_cast<uint32_t>(node->_id);
+  };
+  std::vector<std::pair<uint32_t, uint32_t>> new_edges;
+  new_edges.reserve(delta.insert_edges.size());
+  for(const auto& [from, to] : delta.insert_edges) {
+    new_edges.emplace_back(key_of(from), key_of(to));
+  }
+
+  // removals alone cannot create a cycle
+  if(check_cycle && !new_edges.empty() &&
+     _has_cycle_after_edit(removed_nodes, removed_edges, delta.insert_nodes.size(), new_edges)) {
+    throw std::runtime_error("apply: batch creates a cycle");
+  }
+
+  // 2) remember the tasks to patch, removal resets them in _store
+  const bool sync_tasks = (mode == RunMode::Semaphore || mode == RunMode::IncrementalPartition);
+  std::vector<std::pair<tf::Task, tf::Task>> unlinked_tasks;
+  std::vector<tf::Task> erased_tasks;
+  if(sync_tasks) {
+    for(Edge* edge : removed_edges) {
+      unlinked_tasks.emplace_back(_store.task[edge->_from->_id], _store.task[edge->_to->_id]);
+    }
+    for(Node* node : removed_nodes) {
+      erased_tasks.push_back(_store.task[node->_id]);
+    }
+  }
+
+  // 3) structural edits without per-op taskflow bookkeeping
+  for(Edge* edge : removed_edges) {
+    _remove_edge(edge, RunMode::None);
+  }
+  for(Node* node : removed_nodes) {
+    _remove_node(node, RunMode::None);
+  }
+
+  std::vector<Node*> new_nodes;
+  new_nodes.reserve(delta.insert_nodes.size());
+  _nodes.reserve(_nodes.size() + delta.insert_nodes.size());
+  for(const std::string& name : delta.insert_nodes) {
+    new_nodes.push_back(_insert_node(name, RunMode::None, matrix_size));
+  }
+
+  // group the new edges by source so each fanout list grows at most once
+  auto node_of = [&](uint32_t key) {
+    return key < num_ids ? _store.node[key] : new_nodes[key - num_ids];
+  };
+  std::sort(new_edges.begin(), new_edges.end());
+  std::vector<Edge*> added_edges;
+  added_edges.reserve(new_edges.size());
+  _edges.reserve(_edges.size() + new_edges.size());
+  for(size_t beg=0, end=0; beg<new_edges.size(); beg=end) {
+    Node* from = node_of(new_edges[beg].first);
+    while(end < new_edges.size() && new_edges[end].first == new_edges[beg].first) {
+      ++end;
+    }
+    EdgeList& fanouts = _store.fanouts[from->_id];
+    fanouts.reserve(fanouts.size() + (end - beg));
+    for(size_t i=beg; i<end; i++) {
+      size_t num_edges = _edges.size();
+      Edge* edge = _insert_edge(from, node_of(new_edges[i].second), RunMode::None);
+      // the edge index may have rejected a parallel edge
+      if(_edges.size() != num_edges) {
+        added_edges.push_back(edge);
+      }
+    }
+  }
+
+  // 4) patch the taskflow once for the whole batch
+  auto start_construct = std::chrono::steady_clock::now();
+  if(sync_tasks) {
+    for(auto& [from, to] : unlinked_tasks) {
+      from.remove_successors(to);
+      to.remove_predecessors(from);
+    }
+    for(tf::Task& task : erased_tasks) {
+      _taskflow.erase(task);
+    }
+    for(Node* node : new_nodes) {
+      _emplace_task(node, mode, matrix_size);
+    }
+    for(Edge* edge : added_edges) {
+      _store.task[edge->_from->_id].precede(_store.task[edge->_to->_id]);
+    }
+  }
+  auto end_construct = std::chrono::steady_clock::now();
+  size_t taskflow_constucttime = std::chrono::duration_cast<std::chrono::microseconds>(end_construct-start_construct).count();
+  _incre_runtime_with_semaphore_graph_construct += taskflow_constucttime;
+  _incre_construct_runtime_with_cudaflow += taskflow_constucttime;
+
+  std::vector<NodeId> new_ids;
+  new_ids.reserve(new_nodes.size());
+  for(Node* node : new_nodes) {
+    new_ids.push_back(_handle(node));
+  }
+  return new_ids;
+}
+
+bool Graph::_has_cycle_after_edit(const std::vector<Node*>& removed_nodes, const std::vector<Edge*>& removed_edges,
+                                  size_t num_new_nodes, const std::vector<std::pair<uint32_t, uint32_t>>& new_edges) {
+
+  // Kahn's algorithm on the graph as it would look after the edit,
+  // without materializing it: existing adjacency minus removed nodes/edges plus new edges
+  const size_t num_ids = _store.size();
+  std::vector<char> node_gone(num_ids, 0);
+  for(Node* node : removed_nodes) {
+    node_gone[node->_id] = 1;
+  }
+  std::vector<char> edge_gone(_edge_pool.capacity(), 0);
+  for(Edge* edge : removed_edges) {
+    edge_gone[ObjectPool<Edge>::index_of(edge)] = 1;
+  }
+  auto kept = [&](const Edge* edge) {
+    return !edge_gone[ObjectPool<Edge>::index_of(edge)] && !node_gone[edge->_to->_id];
+  };
+
+  std::vector<std::pair<uint32_t, uint32_t>> extra(new_edges);
+  std::sort(extra.begin(), extra.end());
+
+  std::vector<size_t> indegrees(num_ids + num_new_nodes, 0);
+  for(Node* node : _nodes) {
+    if(node_gone[node->_id]) {
+      continue;
+    }
+    for(Edge* edge : _store.fanouts[node->_id]) {
+      if(kept(edge)) {
+        ++indegrees[edge->_to->_id];
+      }
+    }
+  }
+  for(const auto& [from, to] : extra) {
+    ++indegrees[to];
+  }
+
+  const size_t n = _nodes.size() - removed_nodes.size() + num_new_nodes;
+  std::vector<uint32_t> q;
+  q.reserve(n);
+  for(Node* node : _nodes) {
+    if(!node_gone[node->_id] && indegrees[node->_id] == 0) {
+      q.push_back(static_cast<uint32_t>(node->_id));
+    }
+  }
+  for(size_t i=0; i<num_new_nodes; i++) {
+    if(indegrees[num_ids + i] == 0) {
+      q.push_back(static_cast<uint32_t>(num_ids + i));
+    }
+  }
+
+  for(size_t head=0; head<q.size(); head++) {
+    uint32_t cur = q[head];
+    if(cur < num_ids) {
+      for(Edge* edge : _store.fanouts[cur]) {
+        if(kept(edge) && --indegrees[edge->_to->_id] == 0) {
+          q.push_back(static_cast<uint32_t>(edge->_to->_id));
+        }
+      }
+    }
+    auto it = std::lower_bound(extra.begin(), extra.end(), std::make_pair(cur, uint32_t{0}));
+    for(; it != extra.end() && it->first == cur; ++it) {
+      if(--indegrees[it->second] == 0) {
+        q.push_back(it->second);
+      }
+    }
+  }
+
+  return q.size() != n;
+}
+
+void Graph::compact() {
+
+  const size_t num_ids = _store.size();
+
+  // Kahn's algorithm gives a level-by-level topological order of the current ids
+  std::vector<size_t> indegrees(num_ids, 0);
+  std::vector<uint32_t> order;
+  order.reserve(_nodes.size());
+  for(auto node : _nodes) {
+    indegrees[node->_id] = _store.fanins[node->_id].size();
+    if(indegrees[node->_id] == 0) {
+      order.push_back(static_cast<uint32_t>(node->_id));
+    }
+  }
+  for(size_t head=0; head<order.size(); head++) {
+    for(auto edge : _store.fanouts[order[head]]) {
+      if(--indegrees[edge->_to->_id] == 0) {
+        order.push_back(static_cast<uint32_t>(edge->_to->_id));
+      }
+    }
+  }
+  // nodes on a cycle are never released, keep them in their current order
+  if(order.size() < _nodes.size()) {
+    for(auto node : _nodes) {
+      if(indegrees[node->_id] > 0) {
+        order.push_back(static_cast<uint32_t>(node->_id));
+      }
+    }
+  }
+
+  // move the attributes to the new ids
+  _store.permute(order);
+  for(size_t i=0; i<order.size(); i++) {
+    Node* node = _store.node[i];
+    node->_id = static_cast<int>(i);
+    node->_node_satellite = i;
+    _nodes[i] = node;
+  }
+
+  // sort adjacency by the new ids and rebuild _edges in source order
+  _edges.clear();
+  for(size_t i=0; i<order.size(); i++) {
+    EdgeList& fanouts = _store.fanouts[i];
+    std::sort(fanouts.begin(), fanouts.end(), [](Edge* a, Edge* b) {
+      return a->_to->_id < b->_to->_id;
+    });
+    for(size_t pos=0; pos<fanouts.size(); pos++) {
+      fanouts[pos]->_from_pos = pos;
+      fanouts[pos]->_satellite = _edges.size();
+      _edges.push_back(fanouts[pos]);
+    }
+    EdgeList& fanins = _store.fanins[i];
+    std::sort(fanins.begin(), fanins.end(), [](Edge* a, Edge* b) {
+      return a->_from->_id < b->_from->_id;
+    });
+    for(size_t pos=0; pos<fanins.size(); pos++) {
+      fanins[pos]->_to_pos = pos;
+    }
+  }
+
+  // the edge index is keyed by ids
+  if(_edge_index_enabled) {
+    enable_edge_index(true);
+  }
+
+  _num_node_edits = 0;
+  _frozen_valid = false;
+  _chains_valid = false;
+}
+
+const FrozenGraph& Graph::freeze() {
+
+  if(_frozen_valid) {
+    return _frozen;
+  }
+
+  if(_compact_threshold > 0 && _num_node_edits > _compact_threshold * _nodes.size()) {
+    compact();
+  }
+
+  // node ids already index _store, so no renumbering is needed
+  const size_t num_ids = _store.size();
+
+  _frozen.ids.clear();
+  _frozen.ids.reserve(_nodes.size());
+  for(auto node : _nodes) {
+    _frozen.ids.push_back(static_cast<uint32_t>(node->_id));
+  }
+  _frozen.nodes = _store.node;
+
+  // prefix sums of degrees give the offsets
+  // free ids have no fanins/fanouts
+  _frozen.fanin_offsets.resize(num_ids+1);
+  _frozen.fanout_offsets.resize(num_ids+1);
+  _frozen.fanin_offsets[0] = 0;
+  _frozen.fanout_offsets[0] = 0;
+  for(size_t v=0; v<num_ids; v++) {
+    Node* node = _frozen.nodes[v];
+    _frozen.fanin_offsets[v+1] = _frozen.fanin_offsets[v] + (node ? _store.fanins[v].size() : 0);
+    _frozen.fanout_offsets[v+1] = _frozen.fanout_offsets[v] + (node ? _store.fanouts[v].size() : 0);
+  }
+
+  _frozen.fanins.resize(_frozen.fanin_offsets[num_ids]);
+  _frozen.fanouts.resize(_frozen.fanout_offsets[num_ids]);
+  for(auto node : _nodes) {
+    size_t i = _frozen.fanin_offsets[node->_id];
+    for(auto edge : _store.fanins[node->_id]) {
+      _frozen.fanins[i++] = static_cast<uint32_t>(edge->_from->_id);
+    }
+    i = _frozen.fanout_offsets[node->_id];
+    for(auto edge : _store.fanouts[node->_id]) {
+      _frozen.fanouts[i++] = static_cast<uint32_t>(edge->_to->_id);
+    }
+  }
+
+  _frozen_valid = true;
+  return _frozen;
+}
+
+const ChainCompression& Graph::compress_chains(size_t max_cost) {
+
+  if(_chains_valid && _frozen_valid && _chains_max_cost == max_cost) {
+    return _chains;
+  }
+
+  const FrozenGraph& g = freeze();
+  ChainCompression& c = _chains;
+  const size_t num_ids = g.num_ids();
+  const size_t n = g.num_nodes();
+  const size_t num_chunks = std::clamp<size_t>(n / CPastaNodesPerThread, 1, _executor.num_workers());
+
+  // v is the next member of the chain of u
+  auto next_of = [&g](uint32_t u) -> uint32_t {
+    if(g.num_fanouts(u) == 1) {
+      uint32_t v = g.fanouts[g.fanout_offsets[u]];
+      if(g.num_fanins(v) == 1) {
+        return v;
+      }
+    }
+    return NoNode;
+  };
+
+  // a chain starts at every node that does not continue the chain of its only fanin
+  auto is_head = [&g, &next_of](uint32_t v) {
+    return g.num_fanins(v) != 1 || next_of(g.fanins[g.fanin_offsets[v]]) != v;
+  };
+
+  // walk the chain from head, calling on_member(member, opens) where opens tells
+  // that the member starts a new segment
+  auto walk = [this, &next_of, max_cost](uint32_t head, auto&& on_member) {
+    size_t segment_cost = 0;
+    for(uint32_t u=head; u!=NoNode; u=next_of(u)) {
+      const uint32_t cost = _store.cost[u];
+      const bool opens = (u == head) || (max_cost > 0 && !fits(segment_cost, cost, max_cost));
+      segment_cost = (opens ? 0 : segment_cost) + cost;
+      on_member(u, opens);
+    }
+  };
+
+  /*
+   * three passes over contiguous chunks of g.ids, in parallel:
+   * count the segments and members of the chains that start in every chunk,
+   * take prefix sums, and fill in the chains at their offsets,
+   * so supernodes are numbered in the order of their heads in g.ids.
+   * a cycle has no head, its nodes are never reached
+   */
+  std::vector<size_t> num_segments(num_chunks + 1, 0);
+  std::vector<size_t> num_members(num_chunks + 1, 0);
+  for_each_chunk(_executor, n, num_chunks, [&](size_t beg, size_t end, size_t k) {
+    for(size_t i=beg; i<end; i++) {
+      if(is_head(g.ids[i])) {
+        walk(g.ids[i], [&](uint32_t, bool opens) {
+          num_segments[k+1] += opens;
+          ++num_members[k+1];
+        });
+      }
+    }
+  });
+  std::partial_sum(num_segments.begin(), num_segments.end(), num_segments.begin());
+  std::partial_sum(num_members.begin(), num_members.end(), num_members.begin());
+  if(num_members[num_chunks] != n) {
+    throw std::runtime_error("The DAG has a cycle");
+  }
+
+  const size_t num_super = num_segments[num_chunks];
+  c.member_offsets.resize(num_super + 1);
+  c.members.resize(n);
+  c.super_of.assign(num_ids, NoNode);
+  c.cost.assign(num_super, 0);
+  for_each_chunk(_executor, n, num_chunks, [&](size_t beg, size_t end, size_t k) {
+    size_t s = num_segments[k];
+    size_t m = num_members[k];
+    for(size_t i=beg; i<end; i++) {
+      if(is_head(g.ids[i])) {
+        walk(g.ids[i], [&](uint32_t u, bool opens) {
+          if(opens) {
+            c.member_offsets[s++] = m;
+          }
+          c.super_of[u] = static_cast<uint32_t>(s - 1);
+          c.members[m++] = u;
+          c.cost[s-1] = static_cast<uint32_t>(std::min<uint64_t>(
+            uint64_t{c.cost[s-1]} + _store.cost[u], std::numeric_limits<uint32_t>::max()
+          ));
+        });
+      }
+    }
+  });
+  c.member_offsets[num_super] = n;
+
+  // the fanins of a supernode are those of its first member, the fanouts those of its last
+  FrozenGraph& cg = c.graph;
+  cg.ids.resize(num_super);
+  std::iota(cg.ids.begin(), cg.ids.end(), 0);
+  cg.nodes.resize(num_super);
+  cg.fanin_offsets.resize(num_super + 1);
+  cg.fanout_offsets.resize(num_super + 1);
+  cg.fanin_offsets[0] = 0;
+  cg.fanout_offsets[0] = 0;
+  for(size_t s=0; s<num_super; s++) {
+    uint32_t first = c.members[c.member_offsets[s]];
+    uint32_t last = c.members[c.member_offsets[s+1] - 1];
+    cg.nodes[s] = g.nodes[first];
+    cg.fanin_offsets[s+1] = cg.fanin_offsets[s] + g.num_fanins(first);
+    cg.fanout_offsets[s+1] = cg.fanout_offsets[s] + g.num_fanouts(last);
+  }
+  cg.fanins.resize(cg.fanin_offsets[num_super]);
+  cg.fanouts.resize(cg.fanout_offsets[num_super]);
+  const size_t super_chunks = std::clamp<size_t>(num_super / CPastaNodesPerThread, 1, _executor.num_workers());
+  for_each_chunk(_executor, num_super, super_chunks, [&](size_t beg, size_t end, size_t) {
+    for(size_t s=beg; s<end; s++) {
+      uint32_t first = c.members[c.member_offsets[s]];
+      uint32_t last = c.members[c.member_offsets[s+1] - 1];
+      size_t i = cg.fanin_offsets[s];
+      for(size_t e=g.fanin_offsets[first]; e<g.fanin_offsets[first+1]; e++) {
+        cg.fanins[i++] = c.super_of[g.fanins[e]];
+      }
+      i = cg.fanout_offsets[s];
+      for(size_t e=g.fanout_offsets[last]; e<g.fanout_offsets[last+1]; e++) {
+        cg.fanouts[i++] = c.super_of[g.fanouts[e]];
+      }
+    }
+  });
+
+  _chains_valid = true;
+  _chains_max_cost = max_cost;
+  return c;
+}
+
+bool Graph::has_cycle_before_partition() {
+
+  const FrozenGraph& g = freeze();
+  const size_t n = g.num_nodes();
+
+  // run topological sort (Kahn's algorithm) on the snapshot
+  std::vector<size_t> indegrees(g.num_ids());
+  std::vector<uint32_t> q;
+  q.reserve(n);
+  for(uint32_t v : g.ids) {
+    indegrees[v] = g.num_fanins(v);
+    if(indegrees[v] == 0) {
+      q.push_back(v);
+    }
+  }
+
+  for(size_t head=0; head<q.size(); head++) {
+    uint32_t cur = q[head];
+    for(size_t e=g.fanout_offsets[cur]; e<g.fanout_offsets[cur+1]; e++) {
+      if(--indegrees[g.fanouts[e]] == 0) {
+        q.push_back(g.fanouts[e]);
+      }
+    }
+  }
+
+  // if the size of topological sequence is equal to
+  // the total number of nodes, then no cycle
+  if(q.size() == n) {
+    return false;
+  }
+  else {
+    return true;
+  }
+}
+
+void Graph::remove_random_nodes(size_t N, std::mt19937& gen, RunMode mode) {
+
+  N = std::min(N, _nodes.size());
+  if (N == 0) return;
+
+  // collect pointers
+  std::vector<Node*> cand(_nodes.begin(), _nodes.end());
+
+  std::shuffle(cand.begin(), cand.end(), gen);
+  cand.resize(N);
+
+  GraphDelta delta;
+  for (Node* p : cand) delta.remove_node(_handle(p));
+  _apply(delta, mode, 8, false);
+
+}
+
+void Graph::remove_random_edges(size_t N, std::mt19937& gen, RunMode mode) {
+
+  N = std::min(N, _edges.size());
+  if (N == 0) return;
+
+  std::vector<Edge*> cand(_edges.begin(), _edges.end());
+
+  std::shuffle(cand.begin(), cand.end(), gen);
+  cand.resize(N);
+
+  GraphDelta delta;
+  for (Edge* p : cand) delta.remove_edge(_handle(p));
+  _apply(delta, mode, 8, false);
+}
+
+size_t Graph::add_random_edges(size_t N, std::mt19937& gen, size_t max_tries_multiplier, RunMode mode) {
+
+  std::vector<Node*> topo;
+  topo.reserve(_nodes.size());
+  _get_topo_reverse_order_dfs(topo);
+
+  if (topo.size() < 2 || N == 0) return 0;
+
+  // _get_topo_reverse_order_dfs() is reverse topo because _topo_dfs pushes after recursion
+  std::reverse(topo.begin(), topo.end());
+
+  const size_t n = topo.size();
+
+  // Max possible edges under this ordering is n*(n-1)/2; clamp N to avoid nonsense.
+  const size_t max_possible = n * (n - 1) / 2;
+  if (N > max_possible) N = max_possible;
+
+  size_t added = 0;
+  const size_t max_tries = max_tries_multiplier * N + 100;
+
+  std::uniform_int_distribution<size_t> dis_i(0, n - 2);
+
+  // edges are collected into one batch, so duplicates within the batch are tracked separately
+  GraphDelta delta;
+  std::unordered_set<uint64_t> pending;
+
+  for (size_t tries = 0; tries < max_tries && added < N; ++tries) {
+    const size_t i = dis_i(gen);
+    std::uniform_int_distribution<size_t> dis_j(i + 1, n - 1);
+    const size_t j = dis_j(gen);
+
+    Node* from = topo[i];
+    Node* to   = topo[j];
+
+    // avoid duplicates
+    if (_find_edge(from, to)) continue;
+    uint64_t key = (static_cast<uint64_t>(from->_id) << 32) | static_cast<uint32_t>(to->_id);
+    if (!pending.insert(key).second) continue;
+
+    delta.add_edge(_handle(from), _handle(to));
+    ++added;
+  }
+
+  // every edge goes forward in a topological order, so the batch is acyclic
+  _apply(delta, mode, 8, false);
+
+  return added;  // could be < N if graph is already dense
+}
+
+std::vector<NodeId> Graph::add_random_nodes(size_t N, std::mt19937& gen, 
+                                            const std::string& name_prefix, 
+                                            RunMode mode, size_t matrix_size) {
+
+  GraphDelta delta;
+
+  // 1) insert nodes
+  std::vector<GraphDelta::NodeRef> new_nodes;
+  new_nodes.reserve(N);
+  for (size_t i = 0; i < N; ++i) {
+    // Make names unique-ish; you can replace with your own global "iteration count"
+    std::string name = name_prefix + "_" + std::to_string(_nodes.size() + i) + "_" + std::to_string(i);
+    new_nodes.push_back(delta.add_node(std::move(name)));
+  }
+
+  // 2) connect each new node with one random existing node
+  // If there were no old nodes, we can't connect to existing nodes
+  if (!_nodes.empty()) {
+    std::uniform_int_distribution<size_t> pick_old(0, _nodes.size() - 1);
+    std::bernoulli_distribution coin(0.5);
+
+    for (const auto& nn : new_nodes) {
+      NodeId ex = _handle(_nodes[pick_old(gen)]);
+
+      // Random direction, but always safe because nn is brand new (no other edges yet)
+      if (coin(gen)) {
+        delta.add_edge(ex, nn);      // existing -> new
+      } else {
+        delta.add_edge(nn, ex);      // new -> existing
+      }
+    }
+  }
+
+  return _apply(delta, mode, matrix_size, false);
+}
+
+bool Graph::has_cycle_after_partition() {
+
+  // reset
+  for(auto cnode : _cnodes) {
+    cnode->_visited = false;
+  }
+
+  std::vector<CNode*> topo_order;
+  for(auto cnode : _cnodes) {
+    if(cnode->_fanins.size() == 0) {
+      _topo_dfs(topo_order, cnode);
+    }
+  }
+
+  // if the size of topological sequence is equal to
+  // the total number of cnodes, then no cycle
+  if(topo_order.size() == _cnodes.size()) {
+    return false;
+  }
+  else {
+    return true;
+  }
+}
+
+void Graph::partition_c_pasta() {
+
+  // check partition_size before partition
+  if(_partition_size == 0) {
+    std::cerr << "please set partition size before partition.\n";
+    std::exit(EXIT_FAILURE);
+  }
+
+  // a chain is clustered as a whole, segments of at most partition_size cost never need
+  // to be split again, and the cluster of a supernode goes to all of its members
+  std::vector<int> cluster_ids;
+  if(_compress_chains) {
+    const ChainCompression& chains = compress_chains(_partition_size);
+    std::vector<uint32_t> size;
+    if(_cpasta_strategy == CPastaStrategy::CriticalPath && !_cpasta_cost_weighted) {
+      size.resize(chains.num_nodes());
+      for(uint32_t s=0; s<size.size(); s++) {
+        size[s] = static_cast<uint32_t>(chains.num_members(s));
+      }
+    }
+    std::vector<int> chain_cluster_ids(chains.num_nodes(), -1);
+    _max_cluster_id = _cluster_c_pasta(chains.graph, chains.cost, size.empty() ? nullptr : &size, chain_cluster_ids);
+    cluster_ids.assign(chains.super_of.size(), -1);
+    for(uint32_t s=0; s<chains.num_nodes(); s++) {
+      for(size_t i=chains.member_offsets[s]; i<chains.member_offsets[s+1]; i++) {
+        cluster_ids[chains.members[i]] = chain_cluster_ids[s];
+      }
+    }
+  }
+  else {
+    const FrozenGraph& g = freeze();
+    cluster_ids.assign(g.num_ids(), -1);
+    _max_cluster_id = _cluster_c_pasta(g, _store.cost, nullptr, cluster_ids);
+  }
+
+  // write back the cluster ids
+  _store.cluster_id.swap(cluster_ids);
+
+  // build partitioned graph
+  _build_partitioned_graph();
+}
+
+int Graph::_cluster_c_pasta(const FrozenGraph& g, const std::vector<uint32_t>& cost,
+                            const std::vector<uint32_t>* size, std::vector<int>& cluster_ids) {
+
+  const size_t num_nodes = g.num_nodes();
+
+  if(_cpasta_strategy == CPastaStrategy::CriticalPath) {
+    _find_critical_paths(g, cost, size);
+    _cpasta_critical_cluster.assign(num_nodes, 0);
+  }
+
+  if(_cpasta_deterministic) {
+    return _assign_cluster_ids_by_level(g, cost, cluster_ids);
+  }
+
+  // reset
+  // the counters and queues are kept across calls, only their contents are reset
+  reset_counters(_cpasta_dep_cnt, g.num_ids());
+  reset_counters(_cpasta_cluster_cnt, num_nodes); // we will have at most num_nodes clusters
+  std::vector<std::atomic<size_t>>& dep_cnt = _cpasta_dep_cnt;
+  std::vector<std::atomic<size_t>>& cluster_cnt = _cpasta_cluster_cnt;
+
+  // the traversal runs on the calling thread plus up to num_workers()-1 workers of _executor,
+  // small graphs do not keep many threads busy so they get fewer of them
+  size_t num_threads = _cpasta_num_threads > 0 ? _cpasta_num_threads :
+                       std::clamp<size_t>(num_nodes / CPastaNodesPerThread, 1, _executor.num_workers());
+  if(_cpasta_queues.size() < num_threads) {
+    std::vector<WorkStealingQueue<uint32_t>>(num_threads).swap(_cpasta_queues);
+  }
+  std::vector<WorkStealingQueue<uint32_t>>& queues = _cpasta_queues;
+
+  /*
+   * termination detection
+   * pending counts the nodes that have been released into a queue but not processed yet.
+   * a node is counted before it is pushed and uncounted only after all of its successors
+   * are counted, so pending drops to 0 exactly when the traversal is done, no matter how
+   * many nodes the linear-chain path processed without ever queueing them.
+   */
+  std::atomic<size_t> pending = 0;
+
+  /*
+   * idle workers park on epoch. a worker that released nodes bumps the epoch and wakes
+   * the parked ones, and the last node wakes everyone up to leave.
+   */
+  std::atomic<uint32_t> epoch = 0;
+  std::atomic<size_t> num_parked = 0;
+
+  auto wake = [&epoch](bool all) {
+    epoch.fetch_add(1, std::memory_order_release);
+    if(all) {
+      epoch.notify_all();
+    }
+    else {
+      epoch.notify_one();
+    }
+  };
+
+  // put all source nodes into the first wsq
+  int cur_cluster_id = -1;
+  for(uint32_t v : g.ids) {
+    if(g.num_fanins(v) == 0) {
+      ++cur_cluster_id;
+      cluster_ids[v] = cur_cluster_id;
+      if(_cpasta_strategy == CPastaStrategy::CriticalPath) {
+        _cpasta_critical_cluster[cur_cluster_id] = _cpasta_critical[v] != NotCritical;
+      }
+      pending.fetch_add(1, std::memory_order_relaxed);
+      queues[0].push(v);
+    }
+  }
+
+  // initialize counters for cluster size
+  std::atomic<int> max_cluster_id = cur_cluster_id;
+
+  // assign cluster id to node v, follow the linear chain it leads (if any),
+  // and release its successors into queue i
+  auto process = [this, &g, &cost, &dep_cnt, &cluster_ids, &cluster_cnt, &max_cluster_id, &pending, &num_parked, &queues, &wake](size_t i, uint32_t v) {
+    _assign_cluster_id(g, cost, v, cluster_ids, cluster_cnt, max_cluster_id);
+    /*
+     * process linear chain
+     * if this node leads a linear chain
+     * there is no need to push its successors into queue
+     */
+    while(g.num_fanouts(v) == 1) {
+      uint32_t successor = g.fanouts[g.fanout_offsets[v]];
+      if(g.num_fanins(successor) != 1) {
+        // check if it is a linear chain
+        break;
+      }
+      v = successor;
+      dep_cnt[v].fetch_add(1, std::memory_order_relaxed);
+      _assign_cluster_id(g, cost, v, cluster_ids, cluster_cnt, max_cluster_id);
+    }
+    // process successors: release the dependents
+    // acq_rel makes the cluster ids of all dependents visible to whoever releases the successor
+    size_t num_released = 0;
+    for(size_t e=g.fanout_offsets[v]; e<g.fanout_offsets[v+1]; e++) {
+      uint32_t successor = g.fanouts[e];
+      if(dep_cnt[successor].fetch_add(1, std::memory_order_acq_rel) == g.num_fanins(successor) - 1) {
+        pending.fetch_add(1, std::memory_order_relaxed);
+        queues[i].push(successor);
+        ++num_released;
+      }
+    }
+    // pairs with the fence of a parking worker: either it sees the new nodes
+    // or we see it parked
+    if(num_released > 0) {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if(num_parked.load(std::memory_order_relaxed) > 0) {
+        wake(num_released > 1);
+      }
+    }
+    // the node is done, the last one ends the traversal
+    if(pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      wake(true);
+    }
+  };
+
+  // try every other queue once, starting after i so thieves spread over the victims
+  auto steal = [&queues, num_threads](size_t i) -> std::optional<uint32_t> {
+    for(size_t k=1; k<num_threads; k++) {
+      if(auto node_opt = queues[(i + k) % num_threads].steal(); node_opt.has_value()) {
+        return node_opt;
+      }
+    }
+    return std::nullopt;
+  };
+
+  auto all_empty = [&queues, num_threads]() {
+    for(size_t j=0; j<num_threads; j++) {
+      if(!queues[j].empty()) {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  /*
+   * worker loop of thread i
+   * any worker can steal from any queue, so the traversal completes
+   * even if the executor starts only some of the workers.
+   * a worker that finds nothing to steal backs off: first a short pause that doubles
+   * every round, then yielding the core, and finally parking until nodes are released
+   */
+  auto worker = [&pending, &epoch, &num_parked, &queues, &process, &steal, &all_empty](size_t i) {
+    size_t num_failed = 0;
+    while(pending.load(std::memory_order_acquire) != 0) {
+
+      // first process tasks in thread i's own queue
+      while(!queues[i].empty()) {
+        if(auto node_opt = queues[i].pop(); node_opt.has_value()) { // if get the node successfully
+          process(i, node_opt.value());
+        }
+      }
+
+      // steal tasks from other threads' queues if its own queue is empty
+      if(auto node_opt = steal(i); node_opt.has_value()) {
+        num_failed = 0;
+        process(i, node_opt.value());
+        continue;
+      }
+
+      ++num_failed;
+      if(num_failed <= CPastaSpinRounds) {
+        for(size_t k=0; k<(size_t{1} << num_failed); k++) {
+          cpu_relax();
+        }
+      }
+      else if(num_failed <= CPastaSpinRounds + CPastaYieldRounds) {
+        std::this_thread::yield();
+      }
+      else {
+        // announce the park before the last look at the queues, see process
+        num_parked.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint32_t e = epoch.load(std::memory_order_acquire);
+        if(pending.load(std::memory_order_acquire) != 0 && all_empty()) {
+          epoch.wait(e, std::memory_order_acquire);
+        }
+        num_parked.fetch_sub(1, std::memory_order_relaxed);
+        num_failed = 0;
+      }
+    }
+  };
+
+  // workers 1..num_threads-1 run on the persistent executor, worker 0 on the calling thread.
+  // worker 0 alone completes the traversal, so workers that did not start by then are dropped
+  TaskJoin join;
+  for(size_t i=1; i<num_threads; i++) {
+    join.async(_executor, [i, &worker]() {
+      worker(i);
+    });
   }
+  worker(0);
+  join.close();
 
-  size_t num_nodes;
-  // read the number of nodes
-  infile >> num_nodes;
+  // record largest cluster id
+  return max_cluster_id.load();
+}
 
-  std::unordered_map<std::string, Node*> name_map;
+void Graph::_assign_cluster_id(const FrozenGraph& g, const std::vector<uint32_t>& cost, uint32_t v,
+                               std::vector<int>& cluster_ids, std::vector<std::atomic<size_t>>& cluster_cnt,
+                               std::atomic<int>& max_cluster_id) {
 
-  // read node names and add them to the graph
-  std::string node_name;
-  for(size_t i=0; i<num_nodes; i++) {
-    infile >> node_name;
-    // remove quotes from node name
-    node_name = node_name.substr(1, node_name.size()-3);
-    name_map[node_name] = insert_node(node_name);
+  int desired_cluster_id = cluster_ids[v]; // cluster_id is initialized as -1(excluding source tasks)
+
+  // choose the largest cluster_id from its dependents as its desired_cluster_id
+  for(size_t e=g.fanin_offsets[v]; e<g.fanin_offsets[v+1]; e++) {
+    int dep_cluster_id = cluster_ids[g.fanins[e]]; // dependent of v
+    if(dep_cluster_id > desired_cluster_id) {
+      desired_cluster_id = dep_cluster_id;
+    }
   }
 
-  // read edges and add them to the graph
-  std::string from, to, arrow;
-  while(infile >> from >> arrow >> to) {
-    from = from.substr(1, from.size()-2);
-    to = to.substr(1, to.size()-3);
-    insert_edge(name_map[from], name_map[to]);
+  const bool joins = g.num_fanins(v) == 0 || _may_join(g, v, desired_cluster_id, cluster_ids);
+
+  // check if the desired cluster still has room for the cost of this node
+  // the cost is reserved by CAS, so a node that does not fit leaves the count untouched
+  // for a cheaper node that still would
+  const uint32_t node_cost = cost[v];
+  std::atomic<size_t>& cnt = cluster_cnt[desired_cluster_id];
+  size_t cur = cnt.load(std::memory_order_relaxed);
+  while(joins && fits(cur, node_cost, _partition_size) &&
+        !cnt.compare_exchange_weak(cur, cur + node_cost, std::memory_order_relaxed)) {
+  }
+  if(joins && fits(cur, node_cost, _partition_size)) {
+    cluster_ids[v] = desired_cluster_id;
+  }
+  // if no, create a new cluster_id by ++max_cluster_id
+  else {
+    int new_cluster_id = max_cluster_id.fetch_add(1, std::memory_order_relaxed) + 1;
+    cluster_ids[v] = new_cluster_id;
+    cluster_cnt[new_cluster_id].fetch_add(node_cost, std::memory_order_relaxed);
+    if(_cpasta_strategy == CPastaStrategy::CriticalPath) {
+      _cpasta_critical_cluster[new_cluster_id] = _cpasta_critical[v] != NotCritical;
+    }
   }
 }
 
-Node* Graph::insert_node(const std::string& name, RunMode mode, size_t matrix_size) {
+int Graph::_assign_cluster_ids_by_level(const FrozenGraph& g, const std::vector<uint32_t>& cost,
+                                        std::vector<int>& cluster_ids) {
 
-  // Node node(name);
-  int id = (int)_nodes.size();
-  Node* node_ptr = &(_nodes.emplace_back(name));
-  node_ptr->_node_satellite = --_nodes.end();
-  node_ptr->_id = id;
+  /*
+   * deterministic C-PASTA
+   * nodes are assigned level by level (a node is in the level after the last of its
+   * fanins) and in a fixed order within a level, so the clusters depend only on the graph:
+   * - the next level lists every released node once, after the fanin that comes last in
+   *   the current level (its owner) and in the order of the owner's fanouts
+   * - nodes that want the same cluster get its room in level order by deterministic
+   *   reservations: in every round the first pending node of each cluster (an atomic min
+   *   over the positions) joins it or gives up, the others retry in the next round
+   * - nodes that give up open new clusters, numbered in level order by a prefix sum
+   * every phase splits the level into contiguous chunks that run in parallel, the same
+   * clusters come out of any chunking
+   */
+  const size_t num_ids = g.num_ids();
+  reset_counters(_cpasta_dep_cnt, num_ids);
+  std::vector<std::atomic<size_t>>& dep_cnt = _cpasta_dep_cnt;
+
+  std::vector<uint64_t> key(num_ids);    // level << 32 | position within the level
+  std::vector<uint64_t> owner(num_ids);  // key of the owner of a released node
+  std::vector<char> listed(num_ids, 0);  // written by the owner only, drops parallel edges
+  std::vector<size_t> cluster_cost(g.num_nodes(), 0);
+  std::vector<std::atomic<uint32_t>> reservation(g.num_nodes());
+  for(auto& r : reservation) {
+    r.store(Unreserved, std::memory_order_relaxed);
+  }
 
-  auto start_construct = std::chrono::steady_clock::now();
-  // if run taskflow with semaphore or incremental partition
-  auto needs_task = [](RunMode m) {
-    return m == RunMode::Semaphore || m == RunMode::IncrementalPartition;
+  auto num_chunks = [this](size_t n) {
+    return std::clamp<size_t>(n / CPastaNodesPerThread, 1, _executor.num_workers());
   };
-  if(needs_task(mode)) {
-    node_ptr->_task = _taskflow.emplace([this, matrix_size]() {
-      // std::this_thread::sleep_for(std::chrono::nanoseconds(task_runtime));
-      size_t N = matrix_size;
-      size_t M = matrix_size;
-      size_t K = matrix_size;
-      std::vector<int> A(N*K, 1);
-      std::vector<int> B(K*M, 2);
-      std::vector<int> C(N*M);
-      for(size_t n=0; n<N; n++) {
-        for(size_t m=0; m<M; m++) {
-          int temp = 0;
-          for(size_t k=0; k<K; k++) {
-            temp += A[n*K + k] * B[k*M + m];
+
+  // sources open the first clusters in the order of g.ids
+  std::vector<uint32_t> level;
+  for(uint32_t v : g.ids) {
+    if(g.num_fanins(v) == 0) {
+      key[v] = level.size();
+      cluster_ids[v] = static_cast<int>(level.size());
+      cluster_cost[level.size()] = cost[v];
+      if(_cpasta_strategy == CPastaStrategy::CriticalPath) {
+        _cpasta_critical_cluster[level.size()] = _cpasta_critical[v] != NotCritical;
+      }
+      level.push_back(v);
+    }
+  }
+  size_t num_clusters = level.size();
+  size_t num_assigned = 0;
+
+  std::vector<int> desired;
+  std::vector<uint32_t> pending;
+  std::vector<std::vector<uint32_t>> next(_executor.num_workers());
+  std::vector<size_t> num_opened(_executor.num_workers() + 1);
+
+  for(uint64_t depth=0; !level.empty(); depth++) {
+
+    const size_t n = level.size();
+    const size_t chunks = num_chunks(n);
+    num_assigned += n;
+
+    if(depth > 0) {
+
+      // the desired cluster of every node, or -1 if it has to open one
+      desired.assign(n, -1);
+      for_each_chunk(_executor, n, chunks, [&](size_t beg, size_t end, size_t) {
+        for(size_t i=beg; i<end; i++) {
+          uint32_t v = level[i];
+          key[v] = depth << 32 | i;
+          int d = -1;
+          for(size_t e=g.fanin_offsets[v]; e<g.fanin_offsets[v+1]; e++) {
+            d = std::max(d, cluster_ids[g.fanins[e]]);
+          }
+          if(_may_join(g, v, d, cluster_ids)) {
+            desired[i] = d;
+          }
+        }
+      });
+
+      pending.clear();
+      for(size_t i=0; i<n; i++) {
+        if(desired[i] >= 0) {
+          pending.push_back(i);
+        }
+      }
+
+      while(!pending.empty()) {
+        // reserve: a node that no longer fits gives up, since clusters only grow
+        for_each_chunk(_executor, pending.size(), num_chunks(pending.size()), [&](size_t beg, size_t end, size_t) {
+          for(size_t p=beg; p<end; p++) {
+            uint32_t i = pending[p];
+            if(!fits(cluster_cost[desired[i]], cost[level[i]], _partition_size)) {
+              desired[i] = -1;
+              continue;
+            }
+            std::atomic<uint32_t>& r = reservation[desired[i]];
+            uint32_t cur = r.load(std::memory_order_relaxed);
+            while(i < cur && !r.compare_exchange_weak(cur, i, std::memory_order_relaxed)) {
+            }
+          }
+        });
+        // commit: the first node of each cluster joins it and frees the reservation
+        for_each_chunk(_executor, pending.size(), num_chunks(pending.size()), [&](size_t beg, size_t end, size_t) {
+          for(size_t p=beg; p<end; p++) {
+            uint32_t i = pending[p];
+            int d = desired[i];
+            if(d >= 0 && reservation[d].load(std::memory_order_relaxed) == i) {
+              cluster_ids[level[i]] = d;
+              cluster_cost[d] += cost[level[i]];
+              reservation[d].store(Unreserved, std::memory_order_relaxed);
+            }
+          }
+        });
+        pending.erase(std::remove_if(pending.begin(), pending.end(), [&](uint32_t i) {
+          return desired[i] < 0 || cluster_ids[level[i]] >= 0;
+        }), pending.end());
+      }
+
+      // open new clusters in level order
+      for_each_chunk(_executor, n, chunks, [&](size_t beg, size_t end, size_t k) {
+        num_opened[k+1] = std::count(desired.begin() + beg, desired.begin() + end, -1);
+      });
+      num_opened[0] = num_clusters;
+      std::partial_sum(num_opened.begin(), num_opened.begin() + chunks + 1, num_opened.begin());
+      for_each_chunk(_executor, n, chunks, [&](size_t beg, size_t end, size_t k) {
+        size_t c = num_opened[k];
+        for(size_t i=beg; i<end; i++) {
+          if(desired[i] < 0) {
+            uint32_t v = level[i];
+            cluster_ids[v] = static_cast<int>(c);
+            cluster_cost[c] = cost[v];
+            if(_cpasta_strategy == CPastaStrategy::CriticalPath) {
+              _cpasta_critical_cluster[c] = _cpasta_critical[v] != NotCritical;
+            }
+            ++c;
+          }
+        }
+      });
+      num_clusters = num_opened[chunks];
+    }
+
+    // release the next level and find the owner of every released node
+    for_each_chunk(_executor, n, chunks, [&](size_t beg, size_t end, size_t) {
+      for(size_t i=beg; i<end; i++) {
+        uint32_t v = level[i];
+        for(size_t e=g.fanout_offsets[v]; e<g.fanout_offsets[v+1]; e++) {
+          uint32_t s = g.fanouts[e];
+          if(dep_cnt[s].fetch_add(1, std::memory_order_acq_rel) == g.num_fanins(s) - 1) {
+            uint64_t o = 0;
+            for(size_t f=g.fanin_offsets[s]; f<g.fanin_offsets[s+1]; f++) {
+              o = std::max(o, key[g.fanins[f]]);
+            }
+            owner[s] = o;
+          }
+        }
+      }
+    });
+    // every owner lists its released fanouts, the chunks are joined in order
+    for_each_chunk(_executor, n, chunks, [&](size_t beg, size_t end, size_t k) {
+      next[k].clear();
+      for(size_t i=beg; i<end; i++) {
+        uint32_t v = level[i];
+        for(size_t e=g.fanout_offsets[v]; e<g.fanout_offsets[v+1]; e++) {
+          uint32_t s = g.fanouts[e];
+          if(dep_cnt[s].load(std::memory_order_relaxed) == g.num_fanins(s) && owner[s] == key[v] && !listed[s]) {
+            listed[s] = 1;
+            next[k].push_back(s);
           }
-          C[n*M + m] = temp;
         }
       }
     });
-    if(mode == RunMode::Semaphore) {
-      node_ptr->_task.acquire(_semaphore);
-      node_ptr->_task.release(_semaphore);
+    level.clear();
+    for(size_t k=0; k<chunks; k++) {
+      level.insert(level.end(), next[k].begin(), next[k].end());
     }
   }
-  auto end_construct = std::chrono::steady_clock::now();
-  size_t taskflow_constucttime = std::chrono::duration_cast<std::chrono::microseconds>(end_construct-start_construct).count();
-  // we won't run semaphore and partitioning in the same program so I just add them both
-  _incre_runtime_with_semaphore_graph_construct += taskflow_constucttime;
-  _incre_construct_runtime_with_cudaflow += taskflow_constucttime;
 
-  return node_ptr;
+  // nodes on a cycle are never released
+  if(num_assigned != g.num_nodes()) {
+    std::cerr << "partition failed: the DAG has a cycle.\n";
+    std::exit(EXIT_FAILURE);
+  }
+
+  return static_cast<int>(num_clusters) - 1;
 }
 
-Edge* Graph::insert_edge(Node* from, Node* to, RunMode mode) {
+bool Graph::_may_join(const FrozenGraph& g, uint32_t v, int desired_cluster_id,
+                      const std::vector<int>& cluster_ids) const {
 
-  // Edge edge;
-  Edge* edge_ptr = &_edges.emplace_back();
+  /*
+   * under CPastaStrategy::CriticalPath a critical node continues the desired cluster only
+   * if that cluster is critical and holds a fanin whose critical successor is this node;
+   * any other node may join it only if it is not critical.
+   * the other branches start new clusters, which spreads them out
+   */
+  if(_cpasta_strategy != CPastaStrategy::CriticalPath) {
+    return true;
+  }
+  if(_cpasta_critical[v] == NotCritical) {
+    return !_cpasta_critical_cluster[desired_cluster_id];
+  }
+  if(!_cpasta_critical_cluster[desired_cluster_id]) {
+    return false;
+  }
+  for(size_t e=g.fanin_offsets[v]; e<g.fanin_offsets[v+1]; e++) {
+    uint32_t u = g.fanins[e];
+    if(cluster_ids[u] == desired_cluster_id && _cpasta_critical[u] == v) {
+      return true;
+    }
+  }
+  return false;
+}
 
-  edge_ptr->_from = from;
-  edge_ptr->_to = to;
+void Graph::_find_critical_paths(const FrozenGraph& g, const std::vector<uint32_t>& cost,
+                                 const std::vector<uint32_t>* size) {
 
-  from->_fanouts.push_back(edge_ptr);
-  to->_fanins.push_back(edge_ptr);
+  auto weight = [this, &cost, size](uint32_t v) -> uint64_t {
+    return _cpasta_cost_weighted ? cost[v] : (size ? (*size)[v] : 1);
+  };
 
-  // tells the index of this edge in _fanouts of from nodes and _fanins of to nodes
-  // for remove_edge()
-  edge_ptr->_from_satellite = --from->_fanouts.end();
-  edge_ptr->_to_satellite = --to->_fanins.end();
+  /*
+   * the bottom level of a node is the length of the longest path from it to a sink,
+   * itself included, the top level that of the longest path from a source to it, itself
+   * excluded; their sum is the longest path through the node.
+   * nodes are visited sinks first (Kahn's algorithm on the fanouts), so the bottom levels
+   * of its fanouts are known when a node is reached, and its critical successor is the
+   * fanout with the largest one (the first on ties)
+   */
+  std::vector<uint64_t> bottom_level(g.num_ids(), 0);
+  std::vector<uint64_t> top_level(g.num_ids(), 0);
+  std::vector<size_t> outdegrees(g.num_ids());
+  _cpasta_critical.resize(g.num_ids());
+
+  std::vector<uint32_t> q;
+  q.reserve(g.num_nodes());
+  for(uint32_t v : g.ids) {
+    outdegrees[v] = g.num_fanouts(v);
+    if(outdegrees[v] == 0) {
+      q.push_back(v);
+    }
+  }
 
-  // tells the index of this edge in _fanouts of from nodes and _fanins of to nodes
-  // but make the index as a pair with nodes, for remove_node()
-  from->_fanout_satellites.push_back(std::make_pair(to, --to->_fanins.end()));
-  to->_fanin_satellites.push_back(std::make_pair(from, --from->_fanouts.end()));
+  uint64_t critical_path = 0;
+  for(size_t head=0; head<q.size(); head++) {
+    uint32_t v = q[head];
+    uint32_t critical = v;
+    uint64_t longest = 0;
+    for(size_t e=g.fanout_offsets[v]; e<g.fanout_offsets[v+1]; e++) {
+      if(bottom_level[g.fanouts[e]] > longest) {
+        longest = bottom_level[g.fanouts[e]];
+        critical = g.fanouts[e];
+      }
+    }
+    _cpasta_critical[v] = critical;
+    bottom_level[v] = longest + weight(v);
+    critical_path = std::max(critical_path, bottom_level[v]);
 
-  edge_ptr->_satellite = --_edges.end();
+    for(size_t e=g.fanin_offsets[v]; e<g.fanin_offsets[v+1]; e++) {
+      if(--outdegrees[g.fanins[e]] == 0) {
+        q.push_back(g.fanins[e]);
+      }
+    }
+  }
 
-  auto start_construct = std::chrono::steady_clock::now();
-  // if run taskflow with semaphore
-  if(mode == RunMode::Semaphore || mode == RunMode::IncrementalPartition) {
-    from->_task.precede(to->_task);
+  // top levels in the reverse order, which is topological
+  for(auto it=q.rbegin(); it!=q.rend(); ++it) {
+    uint32_t v = *it;
+    for(size_t e=g.fanout_offsets[v]; e<g.fanout_offsets[v+1]; e++) {
+      top_level[g.fanouts[e]] = std::max(top_level[g.fanouts[e]], top_level[v] + weight(v));
+    }
   }
-  auto end_construct = std::chrono::steady_clock::now();
-  size_t taskflow_constucttime = std::chrono::duration_cast<std::chrono::microseconds>(end_construct-start_construct).count();
-  _incre_runtime_with_semaphore_graph_construct += taskflow_constucttime;
-  _incre_construct_runtime_with_cudaflow += taskflow_constucttime;
 
-  return edge_ptr;
+  // a node whose longest path is within the slack of the critical path is critical
+  const uint64_t slack = static_cast<uint64_t>(critical_path * _cpasta_critical_slack);
+  for(uint32_t v : g.ids) {
+    if(top_level[v] + bottom_level[v] + slack < critical_path) {
+      _cpasta_critical[v] = NotCritical;
+    }
+  }
 }
 
-void Graph::remove_node(Node* node, RunMode mode) {
+void Graph::partition_multilevel() {
 
-  // remove its fanin/fanout edges from _edges
-  // remove_edge will erase this edge from node->_fanins/fanouts, so no need to pop_front()
-  while(!node->_fanins.empty()) {
-    Edge* from = node->_fanins.front();
-    remove_edge(from);
-  }
-  while(!node->_fanouts.empty()) {
-    Edge* to = node->_fanouts.front();
-    remove_edge(to);
-  }
-  
-  auto start_construct = std::chrono::steady_clock::now();
-  // if run taskflow with semaphore
-  if(mode == RunMode::Semaphore || mode == RunMode::IncrementalPartition) {
-    _taskflow.erase(node->_task);
+  // check partition_size before partition
+  if(_partition_size == 0) {
+    std::cerr << "please set partition size before partition.\n";
+    std::exit(EXIT_FAILURE);
   }
-  auto end_construct = std::chrono::steady_clock::now();
-  size_t taskflow_constucttime = std::chrono::duration_cast<std::chrono::microseconds>(end_construct-start_construct).count();
-  _incre_runtime_with_semaphore_graph_construct += taskflow_constucttime;
-  _incre_construct_runtime_with_cudaflow += taskflow_constucttime;
 
-  _nodes.erase(node->_node_satellite);
-}
+  const FrozenGraph& g = freeze();
 
-void Graph::remove_edge(Edge* edge, RunMode mode) {
+  // level 0 is the snapshot with dense ids and merged parallel edges
+  std::vector<CoarseGraph> levels(1);
+  std::vector<std::vector<uint32_t>> parents(1, std::vector<uint32_t>(g.num_ids(), NoNode));
+  for(size_t i=0; i<g.num_nodes(); i++) {
+    parents[0][g.ids[i]] = static_cast<uint32_t>(i);
+  }
+  contract(g, nullptr, _store.cost, nullptr, parents[0], g.num_nodes(), levels[0]);
+
+  // coarsen, parents[l] maps the nodes of level l-1 to those of level l
+  while(levels.size() < MultilevelMaxLevels) {
+    const CoarseGraph& fine = levels.back();
+    std::vector<uint32_t> parent;
+    size_t num_coarse = match_nodes(fine, _partition_size, parent);
+    if(num_coarse > (1 - MultilevelMinShrink) * fine.graph.num_nodes()) {
+      break;
+    }
+    CoarseGraph coarse;
+    contract(fine.graph, &fine.fanout_weights, fine.cost, &fine.size, parent, num_coarse, coarse);
+    levels.push_back(std::move(coarse));
+    parents.push_back(std::move(parent));
+  }
 
-  Node* from = edge->_from;
-  Node* to = edge->_to;
+  // initial clustering of the coarsest level by C-PASTA, whose cluster ids never
+  // decrease along an edge
+  const CoarseGraph& coarsest = levels.back();
+  std::vector<int> cluster_ids(coarsest.graph.num_ids(), -1);
+  _max_cluster_id = _cluster_c_pasta(coarsest.graph, coarsest.cost, &coarsest.size, cluster_ids);
+  std::vector<size_t> cluster_cost(_max_cluster_id + 1, 0);
+  for(uint32_t v : coarsest.graph.ids) {
+    cluster_cost[cluster_ids[v]] += coarsest.cost[v];
+  }
 
-  // remove edge from _fanouts of from node
-  // also remove edge from _fanout_satellites of from node
-  // this edge should be in the same index as the edge in _fanouts
-  // because they are always inserted and removed at the same time
-  auto index = std::distance(from->_fanouts.begin(), edge->_from_satellite);
-  auto it_satellite = from->_fanout_satellites.begin();
-  std::advance(it_satellite, index);
-  from->_fanouts.erase(edge->_from_satellite);
-  from->_fanout_satellites.erase(it_satellite);
-
-  // same method applied to to node
-  index = std::distance(to->_fanins.begin(), edge->_to_satellite);
-  it_satellite = to->_fanin_satellites.begin();
-  std::advance(it_satellite, index);
-  to->_fanins.erase(edge->_to_satellite);
-  to->_fanin_satellites.erase(it_satellite);
+  // uncoarsen: project the clusters one level down and refine them there
+  refine_clusters(coarsest, _partition_size, cluster_ids, cluster_cost);
+  for(size_t l=levels.size()-1; l>0; l--) {
+    const std::vector<uint32_t>& parent = parents[l];
+    std::vector<int> fine_ids(parent.size());
+    for(size_t v=0; v<parent.size(); v++) {
+      fine_ids[v] = cluster_ids[parent[v]];
+    }
+    cluster_ids.swap(fine_ids);
+    refine_clusters(levels[l-1], _partition_size, cluster_ids, cluster_cost);
+  }
 
-  auto start_construct = std::chrono::steady_clock::now();
-  // if run taskflow with semaphore
-  if(mode == RunMode::Semaphore || mode == RunMode::IncrementalPartition) {
-    from->_task.remove_successors(to->_task);
-    to->_task.remove_predecessors(from->_task);
+  // clusters emptied by refinement are dropped by _build_partitioned_graph
+  std::vector<int> node_cluster_ids(g.num_ids(), -1);
+  for(uint32_t v : g.ids) {
+    node_cluster_ids[v] = cluster_ids[parents[0][v]];
   }
-  auto end_construct = std::chrono::steady_clock::now();
-  size_t taskflow_constucttime = std::chrono::duration_cast<std::chrono::microseconds>(end_construct-start_construct).count();
-  _incre_runtime_with_semaphore_graph_construct += taskflow_constucttime;
-  _incre_construct_runtime_with_cudaflow += taskflow_constucttime;
+  _store.cluster_id.swap(node_cluster_ids);
 
-  _edges.erase(edge->_satellite);
+  // build partitioned graph
+  _build_partitioned_graph();
 }
 
-bool Graph::has_cycle_before_partition() {
+void Graph::_repair_cluster_ids(std::vector<int>& cluster_ids) {
 
-  // reset
-  for(auto& node : _nodes) {
-    node._visited = false;
+  /*
+   * C-PASTA gives every node a cluster id no smaller than those of its fanins,
+   * which is what keeps the cluster graph acyclic. walk the nodes in topological
+   * order and let each one keep its saved cluster as long as that still holds
+   * and the cluster has room; otherwise (new nodes, nodes behind new edges)
+   * place it the way _assign_cluster_id does.
+   */
+  const FrozenGraph& g = freeze();
+
+  int max_cluster_id = -1;
+  for(uint32_t v : g.ids) {
+    max_cluster_id = std::max(max_cluster_id, cluster_ids[v]);
+  }
+  std::vector<size_t> cluster_cnt(max_cluster_id + 1, 0);
+
+  std::vector<size_t> indegrees(g.num_ids());
+  std::vector<uint32_t> q;
+  q.reserve(g.num_nodes());
+  for(uint32_t v : g.ids) {
+    indegrees[v] = g.num_fanins(v);
+    if(indegrees[v] == 0) {
+      q.push_back(v);
+    }
   }
 
-  std::vector<Node*> topo_order;
-  for(auto& node : _nodes) {
-    if(node._fanins.size() == 0) {
-      _topo_dfs(topo_order, &node);
+  for(size_t head=0; head<q.size(); head++) {
+
+    uint32_t v = q[head];
+
+    int desired_cluster_id = -1;
+    for(size_t e=g.fanin_offsets[v]; e<g.fanin_offsets[v+1]; e++) {
+      desired_cluster_id = std::max(desired_cluster_id, cluster_ids[g.fanins[e]]);
+    }
+
+    const uint32_t cost = _store.cost[v];
+    int saved_cluster_id = cluster_ids[v];
+    if(saved_cluster_id >= desired_cluster_id && saved_cluster_id >= 0 &&
+       fits(cluster_cnt[saved_cluster_id], cost, _partition_size)) {
+      // keep the saved cluster
+    }
+    else if(desired_cluster_id >= 0 && fits(cluster_cnt[desired_cluster_id], cost, _partition_size)) {
+      cluster_ids[v] = desired_cluster_id;
+    }
+    else {
+      cluster_ids[v] = ++max_cluster_id;
+      cluster_cnt.push_back(0);
+    }
+    cluster_cnt[cluster_ids[v]] += cost;
+
+    for(size_t e=g.fanout_offsets[v]; e<g.fanout_offsets[v+1]; e++) {
+      if(--indegrees[g.fanouts[e]] == 0) {
+        q.push_back(g.fanouts[e]);
+      }
     }
   }
 
-  // if the size of topological sequence is equal to
-  // the total number of nodes, then no cycle
-  if(topo_order.size() == _nodes.size()) {
-    return false;
+  if(q.size() != g.num_nodes()) {
+    throw std::runtime_error("The DAG has a cycle");
   }
-  else {
-    return true;
+
+  // drop the clusters left empty by removed or moved nodes,
+  // renumbering in increasing order keeps cluster ids monotone along edges
+  std::vector<int> renumber(cluster_cnt.size(), -1);
+  int num_clusters = 0;
+  for(size_t c=0; c<cluster_cnt.size(); c++) {
+    if(cluster_cnt[c] > 0) {
+      renumber[c] = num_clusters++;
+    }
+  }
+  for(uint32_t v : g.ids) {
+    cluster_ids[v] = renumber[cluster_ids[v]];
   }
+
+  _max_cluster_id = num_clusters - 1;
 }
 
-void Graph::remove_random_nodes(size_t N, std::mt19937& gen, RunMode mode) {
+void Graph::_build_partitioned_graph() {
 
-  N = std::min(N, _nodes.size());
-  if (N == 0) return;
+  // only an empty graph has no clusters
+  if(_max_cluster_id < 0 && !_nodes.empty()) {
+    std::cerr << "partition failed: _max_cluster_id is wrong...\n";
+    std::exit(EXIT_FAILURE);
+  }
 
-  // collect pointers
-  std::vector<Node*> cand;
-  cand.reserve(_nodes.size());
-  for (auto& n : _nodes) cand.push_back(std::addressof(n));
+  // a full rebuild ends the tracking of incremental C-PASTA
+  _cpasta_tracking = false;
+  _cpasta_dirty.clear();
+  _cedge_index.clear();
 
-  std::shuffle(cand.begin(), cand.end(), gen);
-  cand.resize(N);
+  const FrozenGraph& g = freeze();
+  const size_t num_nodes = g.num_nodes();
+  const size_t num_chunks = std::clamp<size_t>(num_nodes / CPastaNodesPerThread, 1, _executor.num_workers());
+  std::vector<int>& cluster_ids = _store.cluster_id;
 
-  for (Node* p : cand) remove_node(p, mode); // your existing internal removal
+  /*
+   * the cluster graph is built in three parallel passes over contiguous chunks of nodes:
+   * 1. count the nodes of every cluster, empty clusters are dropped and the others
+   *    renumbered in order, which keeps cluster ids nondecreasing along edges
+   * 2. collect the (from cluster, to cluster) pair of every crossing edge per chunk,
+   *    sorted and run-length encoded
+   * 3. merge the chunks by ranges of from clusters into one sorted list of distinct pairs
+   * every pair then becomes exactly one cedge, so _cedges is a CSR of the cluster graph
+   * grouped by from cluster, and each cedge counts the edges it stands for
+   */
+  size_t num_clusters = _max_cluster_id + 1;
+  reset_counters(_cpasta_cluster_cnt, num_clusters);
+  std::vector<std::atomic<size_t>>& cluster_cnt = _cpasta_cluster_cnt;
+  for_each_chunk(_executor, num_nodes, num_chunks, [&](size_t beg, size_t end, size_t) {
+    for(size_t i=beg; i<end; i++) {
+      cluster_cnt[cluster_ids[g.ids[i]]].fetch_add(1, std::memory_order_relaxed);
+    }
+  });
+
+  std::vector<int> renumber(num_clusters, -1);
+  std::vector<size_t> cluster_sizes;
+  cluster_sizes.reserve(num_clusters);
+  for(size_t c=0; c<num_clusters; c++) {
+    if(size_t cnt = cluster_cnt[c].load(std::memory_order_relaxed); cnt > 0) {
+      renumber[c] = static_cast<int>(cluster_sizes.size());
+      cluster_sizes.push_back(cnt);
+    }
+  }
+  if(cluster_sizes.size() < num_clusters) {
+    for_each_chunk(_executor, num_nodes, num_chunks, [&](size_t beg, size_t end, size_t) {
+      for(size_t i=beg; i<end; i++) {
+        cluster_ids[g.ids[i]] = renumber[cluster_ids[g.ids[i]]];
+      }
+    });
+    num_clusters = cluster_sizes.size();
+    _max_cluster_id = static_cast<int>(num_clusters) - 1;
+  }
 
-}
+  // clear the original graph
+  // cedge slots go back to the free list, cnodes are reused as they are
+  // so their vectors keep the capacity from the previous partition
+  _cedge_pool.clear();
+  _cedges.clear();
+  while(_cnodes.size() > num_clusters) {
+    _cnode_pool.deallocate(_cnodes.back());
+    _cnodes.pop_back();
+  }
+  while(_cnodes.size() < num_clusters) {
+    _cnodes.push_back(_cnode_pool.allocate());
+  }
+  for(size_t c=0; c<num_clusters; c++) {
+    CNode* cnode = _cnodes[c];
+    cnode->_id = static_cast<int>(c);
+    cnode->_nodes.clear();
+    cnode->_fanins.clear();
+    cnode->_fanouts.clear();
+    cnode->_nodes.reserve(cluster_sizes[c]);
+  }
 
-void Graph::remove_random_edges(size_t N, std::mt19937& gen, RunMode mode) {
+  // the nodes of a cluster keep the order of g.ids
+  for(uint32_t v : g.ids) {
+    _cnodes[cluster_ids[v]]->_nodes.push_back(g.nodes[v]);
+  }
 
-  N = std::min(N, _edges.size());
-  if (N == 0) return;
+  // (from << 32 | to, number of edges)
+  using ClusterPair = std::pair<uint64_t, size_t>;
+  auto encode = [](std::vector<uint64_t>& keys, std::vector<ClusterPair>& pairs) {
+    std::sort(keys.begin(), keys.end());
+    pairs.clear();
+    for(uint64_t key : keys) {
+      if(pairs.empty() || pairs.back().first != key) {
+        pairs.emplace_back(key, 0);
+      }
+      ++pairs.back().second;
+    }
+  };
 
-  std::vector<Edge*> cand;
-  cand.reserve(_edges.size());
-  for (auto& e : _edges) cand.push_back(std::addressof(e));
+  std::vector<std::vector<ClusterPair>> pairs(num_chunks);
+  for_each_chunk(_executor, num_nodes, num_chunks, [&](size_t beg, size_t end, size_t k) {
+    std::vector<uint64_t> keys;
+    for(size_t i=beg; i<end; i++) {
+      uint32_t v = g.ids[i];
+      uint64_t from = static_cast<uint32_t>(cluster_ids[v]);
+      for(size_t e=g.fanout_offsets[v]; e<g.fanout_offsets[v+1]; e++) {
+        uint64_t to = static_cast<uint32_t>(cluster_ids[g.fanouts[e]]);
+        if(from != to) {
+          keys.push_back(from << 32 | to);
+        }
+      }
+    }
+    encode(keys, pairs[k]);
+  });
 
-  std::shuffle(cand.begin(), cand.end(), gen);
-  cand.resize(N);
+  std::vector<std::vector<ClusterPair>> merged(num_chunks);
+  if(num_chunks == 1) {
+    merged[0].swap(pairs[0]);
+  }
+  else {
+    for_each_chunk(_executor, num_clusters, num_chunks, [&](size_t lo, size_t hi, size_t r) {
+      std::vector<ClusterPair> run;
+      for(const auto& chunk : pairs) {
+        auto first = std::lower_bound(chunk.begin(), chunk.end(), ClusterPair {uint64_t{lo} << 32, 0});
+        auto last = std::lower_bound(first, chunk.end(), ClusterPair {uint64_t{hi} << 32, 0});
+        run.insert(run.end(), first, last);
+      }
+      std::sort(run.begin(), run.end());
+      for(auto [key, cnt] : run) {
+        if(merged[r].empty() || merged[r].back().first != key) {
+          merged[r].emplace_back(key, 0);
+        }
+        merged[r].back().second += cnt;
+      }
+    });
+  }
 
-  for (Edge* p : cand) {
-    remove_edge(p, mode);
+  // one cedge per distinct pair
+  size_t num_cedges = 0;
+  for(const auto& range : merged) {
+    num_cedges += range.size();
+  }
+  _cedges.reserve(num_cedges);
+  std::vector<size_t> num_fanins(num_clusters, 0);
+  for(const auto& range : merged) {
+    for(auto [key, cnt] : range) {
+      CEdge* cedge = _cedge_pool.allocate();
+      cedge->_from = _cnodes[key >> 32];
+      cedge->_to = _cnodes[key & 0xffffffff];
+      cedge->_num_edges = cnt;
+      cedge->_satellite = _cedges.size();
+      _cedges.push_back(cedge);
+      cedge->_from->_fanouts.push_back(cedge);
+      ++num_fanins[key & 0xffffffff];
+    }
+  }
+  for(size_t c=0; c<num_clusters; c++) {
+    _cnodes[c]->_fanins.reserve(num_fanins[c]);
+  }
+  for(auto cedge : _cedges) {
+    cedge->_to->_fanins.push_back(cedge);
   }
 }
 
-size_t Graph::add_random_edges(size_t N, std::mt19937& gen, size_t max_tries_multiplier, RunMode mode) {
-
-  std::vector<Node*> topo;
-  topo.reserve(_nodes.size());
-  _get_topo_reverse_order_dfs(topo);
-
-  if (topo.size() < 2 || N == 0) return 0;
+void Graph::partition_c_pasta_incremental() {
 
-  // _get_topo_reverse_order_dfs() is reverse topo because _topo_dfs pushes after recursion
-  std::reverse(topo.begin(), topo.end());
+  // check partition_size before partition
+  if(_partition_size == 0) {
+    std::cerr << "please set partition size before partition.\n";
+    std::exit(EXIT_FAILURE);
+  }
 
-  const size_t n = topo.size();
+  if(!_cpasta_tracking || _cpasta_tracked_size != _partition_size) {
+    partition_c_pasta();
+    _track_partitioned_graph();
+    return;
+  }
 
-  // Max possible edges under this ordering is n*(n-1)/2; clamp N to avoid nonsense.
-  const size_t max_possible = n * (n - 1) / 2;
-  if (N > max_possible) N = max_possible;
+  /*
+   * a node is out of place if it has no cluster yet or its cluster is ranked before
+   * the cluster of one of its fanins. it then joins the highest-ranked cluster among its
+   * fanins if there is room (as _assign_cluster_id does), otherwise a new cluster ranked
+   * right after that one, which may put some of its fanouts out of place in turn.
+   * every cluster a node can join this way is ranked below the first cluster after
+   * the highest-ranked fanin cluster of the dirty nodes, so only the nodes reachable
+   * from the dirty nodes through clusters up to that rank are affected; they are placed
+   * once each, in topological order.
+   */
+  uint64_t upper = 0;
+  std::vector<Node*> region;
+  std::unordered_map<int, size_t> indegrees; // of the nodes in the region, within it
+  for(NodeId id : _cpasta_dirty) {
+    if(!contains(id)) {
+      continue;
+    }
+    Node* node = _node(id);
+    if(indegrees.emplace(node->_id, 0).second) {
+      region.push_back(node);
+    }
+    for(auto edge : _store.fanins[node->_id]) {
+      int c = _store.cluster_id[edge->_from->_id];
+      if(c >= 0) {
+        upper = std::max(upper, _cluster_rank[c]);
+      }
+    }
+  }
+  _cpasta_dirty.clear();
+
+  for(size_t i=0; i<region.size(); i++) {
+    for(auto edge : _store.fanouts[region[i]->_id]) {
+      Node* to = edge->_to;
+      auto itr = indegrees.find(to->_id);
+      if(itr == indegrees.end()) {
+        int c = _store.cluster_id[to->_id];
+        if(c >= 0 && _cluster_rank[c] > upper) {
+          continue;
+        }
+        itr = indegrees.emplace(to->_id, 0).first;
+        region.push_back(to);
+      }
+      ++itr->second;
+    }
+  }
 
-  auto has_edge = [](Node* from, Node* to) -> bool {
-    for (auto* e : from->_fanouts) {
-      if (e->_to == to) return true;
+  std::vector<Node*> queue;
+  queue.reserve(region.size());
+  for(auto node : region) {
+    if(indegrees[node->_id] == 0) {
+      queue.push_back(node);
     }
-    return false;
-  };
+  }
 
-  size_t added = 0;
-  const size_t max_tries = max_tries_multiplier * N + 100;
+  for(size_t head=0; head<queue.size(); head++) {
 
-  std::uniform_int_distribution<size_t> dis_i(0, n - 2);
+    Node* node = queue[head];
+    const int v = node->_id;
 
-  for (size_t tries = 0; tries < max_tries && added < N; ++tries) {
-    const size_t i = dis_i(gen);
-    std::uniform_int_distribution<size_t> dis_j(i + 1, n - 1);
-    const size_t j = dis_j(gen);
+    // the highest-ranked fanin cluster
+    int desired_cluster_id = -1;
+    for(auto edge : _store.fanins[v]) {
+      int c = _store.cluster_id[edge->_from->_id];
+      if(desired_cluster_id < 0 || _cluster_rank[c] > _cluster_rank[desired_cluster_id]) {
+        desired_cluster_id = c;
+      }
+    }
 
-    Node* from = topo[i];
-    Node* to   = topo[j];
+    int cluster_id = _store.cluster_id[v];
+    if(cluster_id < 0 || (desired_cluster_id >= 0 && _cluster_rank[cluster_id] < _cluster_rank[desired_cluster_id])) {
+      if(desired_cluster_id >= 0 && fits(_cluster_cost[desired_cluster_id], _store.cost[v], _partition_size)) {
+        cluster_id = desired_cluster_id;
+      }
+      else {
+        cluster_id = _open_cluster(desired_cluster_id);
+      }
+      _move_to_cluster(node, cluster_id);
+    }
 
-    // avoid duplicates
-    if (has_edge(from, to)) continue;
+    for(auto edge : _store.fanouts[v]) {
+      auto itr = indegrees.find(edge->_to->_id);
+      if(itr != indegrees.end() && --itr->second == 0) {
+        queue.push_back(edge->_to);
+      }
+    }
+  }
 
-    insert_edge(from, to, mode);
-    ++added;
+  // a move found the cluster graph out of sync (see _count_cedge), partition from scratch
+  if(!_cpasta_tracking) {
+    partition_c_pasta();
+    _track_partitioned_graph();
+    return;
   }
 
-  return added;  // could be < N if graph is already dense
+  _cpasta_ordered = true;
+  _max_cluster_id = static_cast<int>(_cnodes.size()) - 1;
 }
 
-std::vector<Node*> Graph::add_random_nodes(size_t N, std::mt19937& gen, 
-                                           const std::string& name_prefix, 
-                                           RunMode mode, size_t matrix_size) {
-  std::vector<Node*> old_nodes;
-  old_nodes.reserve(_nodes.size());
-  for (auto& n : _nodes) {
-    old_nodes.push_back(std::addressof(n));
-  }
-
-  std::vector<Node*> new_nodes;
-  new_nodes.reserve(N);
+void Graph::_track_partitioned_graph() {
 
-  // 1) insert nodes
-  for (size_t i = 0; i < N; ++i) {
-    // Make names unique-ish; you can replace with your own global "iteration count"
-    std::string name = name_prefix + "_" + std::to_string(_nodes.size()) + "_" + std::to_string(i);
-    new_nodes.push_back(insert_node(name, mode, matrix_size));
+  // _build_partitioned_graph left one cedge per connected cluster pair, with its edge count
+  _cedge_index.clear();
+  _cedge_index.reserve(_cedges.size());
+  for(auto cedge : _cedges) {
+    _cedge_index.insert(cedge->_from->_id, cedge->_to->_id, cedge);
   }
 
-  // If there were no old nodes, we can't connect to existing nodes
-  if (old_nodes.empty()) return new_nodes;
-
-  auto has_edge = [](Node* from, Node* to) -> bool {
-    for (auto* e : from->_fanouts) {
-      if (e->_to == to) return true;
+  // rank the non-empty clusters in a topological order of the cluster graph
+  const size_t num_clusters = _cnodes.size();
+  _cluster_rank.assign(num_clusters, 0);
+  _cluster_cost.assign(num_clusters, 0);
+  _cluster_order.clear();
+  _free_clusters.clear();
+  for(size_t c=0; c<num_clusters; c++) {
+    for(auto node : _cnodes[c]->_nodes) {
+      _cluster_cost[c] += _store.cost[node->_id];
     }
-    return false;
-  };
-
-  // 2) connect each new node with one random existing node
-  std::uniform_int_distribution<size_t> pick_old(0, old_nodes.size() - 1);
-  std::bernoulli_distribution coin(0.5);
-
-  for (Node* nn : new_nodes) {
-    Node* ex = old_nodes[pick_old(gen)];
+  }
 
-    // Random direction, but always safe because nn is brand new (no other edges yet)
-    if (coin(gen)) {
-      if (!has_edge(ex, nn)) {
-        insert_edge(ex, nn, mode);      // existing -> new
-      }
-    } else {
-      if (!has_edge(nn, ex)) {
-        insert_edge(nn, ex, mode);      // new -> existing
+  std::vector<size_t> indegrees(num_clusters);
+  std::vector<int> order;
+  order.reserve(num_clusters);
+  for(size_t c=num_clusters; c-- > 0;) {
+    indegrees[c] = _cnodes[c]->_fanins.size();
+    if(_cnodes[c]->_nodes.empty()) {
+      _free_clusters.push_back(static_cast<int>(c));
+    }
+    else if(indegrees[c] == 0) {
+      order.push_back(static_cast<int>(c));
+    }
+  }
+  std::reverse(order.begin(), order.end());
+  for(size_t head=0; head<order.size(); head++) {
+    for(auto cedge : _cnodes[order[head]]->_fanouts) {
+      if(--indegrees[cedge->_to->_id] == 0) {
+        order.push_back(cedge->_to->_id);
       }
     }
   }
+  const uint64_t gap = cluster_rank_gap(order.size());
+  for(size_t i=0; i<order.size(); i++) {
+    _cluster_rank[order[i]] = (i + 1) * gap;
+    _cluster_order.emplace_hint(_cluster_order.end(), _cluster_rank[order[i]], order[i]);
+  }
 
-  return new_nodes;
+  _cpasta_tracking = true;
+  _cpasta_ordered = true;
+  _cpasta_tracked_size = _partition_size;
+  _cpasta_dirty.clear();
 }
 
-bool Graph::has_cycle_after_partition() {
+void Graph::_count_cedge(int from, int to, bool insert) {
 
-  // reset
-  for(auto& cnode : _cnodes) {
-    cnode._visited = false;
+  if(from < 0 || to < 0 || from == to) {
+    return;
   }
 
-  std::vector<CNode*> topo_order;
-  for(auto& cnode : _cnodes) {
-    if(cnode._fanins.size() == 0) {
-      _topo_dfs(topo_order, &cnode);
+  CEdge* cedge = _cedge_index.find(from, to);
+  if(insert) {
+    if(cedge == nullptr) {
+      cedge = _cedge_pool.allocate();
+      cedge->_from = _cnodes[from];
+      cedge->_to = _cnodes[to];
+      cedge->_satellite = _cedges.size();
+      _cedges.push_back(cedge);
+      _cnodes[from]->_fanouts.push_back(cedge);
+      _cnodes[to]->_fanins.push_back(cedge);
+      _cedge_index.insert(from, to, cedge);
     }
+    ++cedge->_num_edges;
+    return;
   }
 
-  // if the size of topological sequence is equal to
-  // the total number of cnodes, then no cycle
-  if(topo_order.size() == _cnodes.size()) {
-    return false;
+  // the tracked cluster graph lost this pair, so it cannot be trusted anymore:
+  // stop tracking and let the next incremental partition start over
+  if(cedge == nullptr) {
+    _cpasta_tracking = false;
+    return;
   }
-  else {
-    return true;
+  if(--cedge->_num_edges > 0) {
+    return;
   }
+  // the last edge between the two clusters is gone
+  auto erase = [cedge](std::vector<CEdge*>& cedges) {
+    auto itr = std::find(cedges.begin(), cedges.end(), cedge);
+    *itr = cedges.back();
+    cedges.pop_back();
+  };
+  erase(cedge->_from->_fanouts);
+  erase(cedge->_to->_fanins);
+  CEdge* last = _cedges.back();
+  _cedges[cedge->_satellite] = last;
+  last->_satellite = cedge->_satellite;
+  _cedges.pop_back();
+  _cedge_index.erase(from, to);
+  _cedge_pool.deallocate(cedge);
 }
 
-void Graph::partition_c_pasta() {
+void Graph::_move_to_cluster(Node* node, int cluster_id) {
 
-  // check partition_size before partition
-  if(_partition_size == 0) {
-    std::cerr << "please set partition size before partition.\n";
-    std::exit(EXIT_FAILURE);
-  }
+  const int v = node->_id;
+  const int old_cluster_id = _store.cluster_id[v];
 
-  // reset
-  _max_cluster_id = -1;
-  for(auto& node : _nodes) {
-    node._dep_cnt = 0;
-    node._cluster_id = -1;
+  // move the edges of node over to the new cluster pairs
+  for(auto edge : _store.fanins[v]) {
+    int c = _store.cluster_id[edge->_from->_id];
+    _count_cedge(c, old_cluster_id, false);
+    _count_cedge(c, cluster_id, true);
+  }
+  for(auto edge : _store.fanouts[v]) {
+    int c = _store.cluster_id[edge->_to->_id];
+    _count_cedge(old_cluster_id, c, false);
+    _count_cedge(cluster_id, c, true);
   }
 
-  // initialize threadpool and work stealing queues
-  size_t num_threads = std::thread::hardware_concurrency();
-  std::vector<std::thread> threads;
-  std::vector<WorkStealingQueue<Node*>> queues(num_threads);
-  std::atomic<size_t> node_cnt = 0; // count the num of nodes partitioned
-
-  // put all source nodes into the first wsq
-  int cur_cluster_id = -1;
-  for(auto& node : _nodes) {
-    if(node._fanins.size() == 0) {
-      ++cur_cluster_id;
-      node._cluster_id = cur_cluster_id;
-      queues[0].push(&node);
+  // clusters hold at most partition_size nodes, so a linear search is cheap
+  if(old_cluster_id >= 0) {
+    _cluster_cost[old_cluster_id] -= _store.cost[v];
+    std::vector<Node*>& nodes = _cnodes[old_cluster_id]->_nodes;
+    auto itr = std::find(nodes.begin(), nodes.end(), node);
+    *itr = nodes.back();
+    nodes.pop_back();
+    if(nodes.empty()) {
+      _close_cluster(old_cluster_id);
     }
   }
-
-  // initialize counters for cluster size
-  std::atomic<int> max_cluster_id = cur_cluster_id;
-  std::vector<std::atomic<size_t>> cluster_cnt(_nodes.size()); // we will have at most _nodes.size() clusters
-  for(size_t i=0; i<_nodes.size(); i++) {
-    cluster_cnt[i] = 0;
+  _store.cluster_id[v] = cluster_id;
+  if(cluster_id >= 0) {
+    _cluster_cost[cluster_id] += _store.cost[v];
+    _cnodes[cluster_id]->_nodes.push_back(node);
   }
+}
+
+bool Graph::_reorder_clusters(int from, int to) {
 
   /*
-   * emplace tasks into threadpool
-   * task starts to execute the moment it is in the threadpool
+   * an edge from -> to now goes against the ranks. as in the dynamic topological
+   * order of Pearce and Kelly, only the clusters ranked between the two can be in the
+   * way: those reachable from to and those reaching from. if from is reachable from to
+   * the clusters would form a cycle; otherwise the clusters reaching from take the
+   * lowest of the ranks held by both sets, in their current order, and the others follow.
    */
-  for(size_t i=0; i<num_threads; i++) {
-    threads.emplace_back([this, i, &cluster_cnt, &max_cluster_id, &node_cnt, &queues, num_threads]() {
-      while(node_cnt.load(std::memory_order_relaxed) < _nodes.size()) {
-
-        std::optional<Node*> node_ptr_opt;
-
-        // first process tasks in thread i's own queue
-        while(!queues[i].empty()) {
-          node_ptr_opt = queues[i].pop();
-          if(node_ptr_opt.has_value()) { // if get the node successfully
-            Node* node_ptr = node_ptr_opt.value();
-            node_cnt.fetch_add(1, std::memory_order_relaxed);
-            _assign_cluster_id(node_ptr, cluster_cnt, max_cluster_id);
-            /*
-             * process linear chain
-             * if this node leads a linear chain
-             * there is no need to push its successors into queue
-             */
-            while(node_ptr->_fanouts.size() == 1) {
-              Node* successor = (*(node_ptr->_fanouts.begin()))->_to;
-              if(successor->_fanins.size() != 1) {
-                // check if it is a linear chain
-                break;
-              }
-              node_ptr = successor;
-              node_ptr->_dep_cnt.fetch_add(1);
-              node_cnt.fetch_add(1, std::memory_order_relaxed);
-              _assign_cluster_id(node_ptr, cluster_cnt, max_cluster_id);
-            }
-            // process successors: release the dependents
-            for(auto edge : node_ptr->_fanouts) {
-              Node* successor = edge->_to;
-              if(successor->_dep_cnt.fetch_add(1, std::memory_order_relaxed) == successor->_fanins.size() - 1) {
-                queues[i].push(successor);
-              }
-            }
-          }
-        }
-
-        // steal tasks from other threads' queues if its own queue is empty
-        for(size_t j=0; j<num_threads; j++) {
-          if(j == i) {
-            continue;
-          }
-          node_ptr_opt = queues[j].steal();
-          if(node_ptr_opt.has_value()) {
-            break; // successfully steal one task
-          }
-        }
-        if(!node_ptr_opt.has_value()) {
-          continue; // nothing to steal after traversal
-        }
-        // process the stolen task
-        Node* node_ptr = node_ptr_opt.value();
-        node_cnt.fetch_add(1, std::memory_order_relaxed);
-        _assign_cluster_id(node_ptr, cluster_cnt, max_cluster_id);
-        // process linear chain
-        while(node_ptr->_fanouts.size() == 1) {
-          Node* successor = (*(node_ptr->_fanouts.begin()))->_to;
-          if(successor->_fanins.size() != 1) { // check linear chain
-            break;
-          }
-          node_ptr = successor;
-          node_ptr->_dep_cnt.fetch_add(1);
-          node_cnt.fetch_add(1, std::memory_order_relaxed);
-          _assign_cluster_id(node_ptr, cluster_cnt, max_cluster_id);
-        }
-        // process successors: release the dependents
-        for(auto edge : node_ptr->_fanouts) {
-          Node* successor = edge->_to;
-          if(successor->_dep_cnt.fetch_add(1, std::memory_order_relaxed) == successor->_fanins.size() - 1) {
-            queues[i].push(successor);
-          }
-        }
+  const uint64_t lower = _cluster_rank[to];
+  const uint64_t upper = _cluster_rank[from];
+
+  std::vector<int> forward;
+  std::vector<int> backward;
+  std::unordered_set<int> visited;
+  std::vector<int> stack {to};
+  visited.insert(to);
+  while(!stack.empty()) {
+    int c = stack.back();
+    stack.pop_back();
+    forward.push_back(c);
+    for(auto cedge : _cnodes[c]->_fanouts) {
+      int next = cedge->_to->_id;
+      if(next == from) {
+        return false;
       }
-    });
+      if(_cluster_rank[next] < upper && visited.insert(next).second) {
+        stack.push_back(next);
+      }
+    }
   }
-
-  // join the threads
-  for(auto& thread : threads) {
-    thread.join();
+  stack.push_back(from);
+  visited.insert(from);
+  while(!stack.empty()) {
+    int c = stack.back();
+    stack.pop_back();
+    backward.push_back(c);
+    for(auto cedge : _cnodes[c]->_fanins) {
+      int prev = cedge->_from->_id;
+      if(_cluster_rank[prev] > lower && visited.insert(prev).second) {
+        stack.push_back(prev);
+      }
+    }
   }
 
-  // record largest cluster id
-  _max_cluster_id = max_cluster_id.load();
+  auto by_rank = [this](int a, int b) {
+    return _cluster_rank[a] < _cluster_rank[b];
+  };
+  std::sort(forward.begin(), forward.end(), by_rank);
+  std::sort(backward.begin(), backward.end(), by_rank);
+
+  std::vector<uint64_t> ranks;
+  ranks.reserve(forward.size() + backward.size());
+  for(int c : backward) {
+    ranks.push_back(_cluster_rank[c]);
+    _cluster_order.erase(_cluster_rank[c]);
+  }
+  for(int c : forward) {
+    ranks.push_back(_cluster_rank[c]);
+    _cluster_order.erase(_cluster_rank[c]);
+  }
+  std::sort(ranks.begin(), ranks.end());
 
-  // build partitioned graph
-  _build_partitioned_graph();
+  size_t i = 0;
+  for(int c : backward) {
+    _cluster_rank[c] = ranks[i++];
+    _cluster_order.emplace(_cluster_rank[c], c);
+  }
+  for(int c : forward) {
+    _cluster_rank[c] = ranks[i++];
+    _cluster_order.emplace(_cluster_rank[c], c);
+  }
+  return true;
 }
 
-void Graph::_assign_cluster_id(Node* node_ptr, std::vector<std::atomic<size_t>>& cluster_cnt, std::atomic<int>& max_cluster_id) {
-
-  int desired_cluster_id = node_ptr->_cluster_id; // cluster_id is initialized as -1(excluding source tasks)
-
-  // choose the largest cluster_id from its dependents as its desired_cluster_id
-  for(auto edge_ptr : node_ptr->_fanins) {
-    Node* dep_ptr = edge_ptr->_from; // dependent of node_ptr
-    if(dep_ptr->_cluster_id > desired_cluster_id) {
-      desired_cluster_id = dep_ptr->_cluster_id;
-    }
-  }
+int Graph::_open_cluster(int after) {
 
-  // check if the desired cluster still has space for this node
-  if(cluster_cnt[desired_cluster_id].fetch_add(1, std::memory_order_relaxed) < _partition_size) {
-    node_ptr->_cluster_id = desired_cluster_id;
+  int cluster_id;
+  if(!_free_clusters.empty()) {
+    cluster_id = _free_clusters.back();
+    _free_clusters.pop_back();
   }
-  // if no, create a new cluster_id by ++max_cluster_id
   else {
-    int new_cluster_id = max_cluster_id.fetch_add(1, std::memory_order_relaxed) + 1;
-    node_ptr->_cluster_id = new_cluster_id;
-    cluster_cnt[new_cluster_id]++;
+    cluster_id = static_cast<int>(_cnodes.size());
+    _cnodes.push_back(_cnode_pool.allocate());
+    _cnodes.back()->_id = cluster_id;
+    _cluster_rank.push_back(0);
+    _cluster_cost.push_back(0);
   }
-}
 
-void Graph::_build_partitioned_graph() {
+  // take the middle of the gap between after (-1: the front) and the next cluster
+  auto gap = [this, after]() {
+    uint64_t lo = after < 0 ? 0 : _cluster_rank[after];
+    auto next = _cluster_order.upper_bound(lo);
+    uint64_t hi = next != _cluster_order.end() ? next->first :
+                  lo + std::min(2 * cluster_rank_gap(_cluster_order.size()), std::numeric_limits<uint64_t>::max() - lo);
+    return std::pair {lo, hi};
+  };
+  auto [lo, hi] = gap();
+  if(hi - lo < 2) {
+    _relabel_clusters();
+    std::tie(lo, hi) = gap();
+  }
+  _cluster_rank[cluster_id] = lo + (hi - lo) / 2;
+  _cluster_order.emplace(_cluster_rank[cluster_id], cluster_id);
+  return cluster_id;
+}
 
-  // clear the original graph
-  _cnodes.clear();
-  _cedges.clear();
+void Graph::_close_cluster(int cluster_id) {
+  _cluster_order.erase(_cluster_rank[cluster_id]);
+  _free_clusters.push_back(cluster_id);
+}
 
-  if(_max_cluster_id < 0) {
-    std::cerr << "partition failed: _max_cluster_id is wrong...\n";
-    std::exit(EXIT_FAILURE);
+void Graph::_relabel_clusters() {
+  std::map<uint64_t, int> order;
+  const uint64_t gap = cluster_rank_gap(_cluster_order.size());
+  uint64_t rank = 0;
+  for(auto [old_rank, c] : _cluster_order) {
+    rank += gap;
+    _cluster_rank[c] = rank;
+    order.emplace_hint(order.end(), rank, c);
   }
-  size_t num_clusters = _max_cluster_id + 1;
+  _cluster_order.swap(order);
+}
+
+bool Graph::is_c_pasta_partition_consistent() {
 
-  // use a 2-D vector to record clusters (cuz it supports constant time random access)
-  std::vector<std::vector<Node*>> clusters(num_clusters);
-  for(auto& node : _nodes) {
-    int cluster = node._cluster_id;
-    clusters[cluster].push_back(&node);
+  size_t num_placed = 0;
+  for(size_t c=0; c<_cnodes.size(); c++) {
+    size_t cost = 0;
+    for(auto node : _cnodes[c]->_nodes) {
+      if(_store.cluster_id[node->_id] != static_cast<int>(c)) {
+        return false;
+      }
+      cost += _store.cost[node->_id];
+    }
+    if(_cnodes[c]->_nodes.size() > 1 && cost > _partition_size) {
+      return false;
+    }
+    num_placed += _cnodes[c]->_nodes.size();
+  }
+  if(num_placed != _nodes.size()) {
+    return false;
   }
 
-  // construct CNode
-  for(size_t i=0; i<num_clusters; i++) {
-    CNode* cnode_ptr = &(_cnodes.emplace_back());
-    if(clusters[i].size() == 0) {
-      continue;
+  // every connected cluster pair has exactly one cedge, which counts the edges between them
+  std::map<std::pair<int, int>, size_t> expected;
+  for(auto edge : _edges) {
+    int from = _store.cluster_id[edge->_from->_id];
+    int to = _store.cluster_id[edge->_to->_id];
+    if(from != to) {
+      ++expected[{from, to}];
     }
-    for(auto node_ptr : clusters[i]) {
-      cnode_ptr->_nodes.emplace_back(node_ptr);
-      node_ptr->_cnode = cnode_ptr;
-    }
-  }
-
-  // construct CEdge
-  // e.g., to find fanouts,
-  // 1. traverse nodes within a cluster node
-  // 2. for each node, find their fanout nodes
-  // 3. find the cluster nodes to which these fanout nodes belong
-  // 4. add edge
-  // Note. Redundent edges will be added.
-  size_t itr = 0; // to iterate clusters
-  for(auto& cnode : _cnodes) {
-    // add fanouts
-    for(auto node_ptr : clusters[itr]) {
-      for(auto node_fanouts : node_ptr->_fanouts) {
-        Node* successor_ptr = node_fanouts->_to;
-        // if this node is already in the cluster, ignore it
-        if(successor_ptr->_cluster_id == node_ptr->_cluster_id) {
-          continue;
-        }
-        CNode* to = successor_ptr->_cnode;
-        CEdge* cedge_ptr = &(_cedges.emplace_back());
-        cedge_ptr->_from = &cnode;
-        cedge_ptr->_to = to;
-        cnode._fanouts.emplace_back(cedge_ptr);
-        to->_fanins.emplace_back(cedge_ptr);
-      }
+  }
+  for(size_t i=0; i<_cedges.size(); i++) {
+    CEdge* cedge = _cedges[i];
+    auto itr = expected.find({cedge->_from->_id, cedge->_to->_id});
+    if(itr == expected.end() || itr->second != cedge->_num_edges || cedge->_satellite != i) {
+      return false;
     }
+    expected.erase(itr);
+  }
+  if(!expected.empty()) {
+    return false;
+  }
 
-    // add fanins
-    for(auto node_ptr : clusters[itr]) {
-      for(auto node_fanins : node_ptr->_fanins) {
-        Node* dependent_ptr = node_fanins->_from;
-        // if this node is already in the cluster, ignore it
-        if(dependent_ptr->_cluster_id == node_ptr->_cluster_id) {
-          continue;
-        }
-        CNode* from = dependent_ptr->_cnode;
-        CEdge* cedge_ptr = &(_cedges.emplace_back());
-        cedge_ptr->_to = &cnode;
-        cedge_ptr->_from = from;
-        cnode._fanins.emplace_back(cedge_ptr);
-        from->_fanouts.emplace_back(cedge_ptr);
+  // and appears once in the fanouts of its from cluster and the fanins of its to cluster
+  size_t num_fanouts = 0;
+  size_t num_fanins = 0;
+  for(auto cnode : _cnodes) {
+    for(auto cedge : cnode->_fanouts) {
+      if(cedge->_from != cnode) {
+        return false;
       }
     }
-      // remove the duplicates
-    cnode._fanouts.unique();
-    cnode._fanins.unique();
-
-    ++itr;
+    for(auto cedge : cnode->_fanins) {
+      if(cedge->_to != cnode) {
+        return false;
+      }
+    }
+    num_fanouts += cnode->_fanouts.size();
+    num_fanins += cnode->_fanins.size();
   }
+  return num_fanouts == _cedges.size() && num_fanins == _cedges.size();
 }
 
 void Graph::run_graph_before_partition(size_t matrix_size) {
@@ -610,30 +3769,36 @@ void Graph::run_graph_before_partition(size_t matrix_size) {
   tf::Taskflow taskflow;
   tf::Executor executor;
 
-  for(auto& node : _nodes) {
-    node._task = taskflow.emplace([this, matrix_size]() {
-      // std::this_thread::sleep_for(std::chrono::nanoseconds(task_runtime));
-      size_t N = matrix_size;
-      size_t M = matrix_size;
-      size_t K = matrix_size;
-      std::vector<int> A(N*K, 1);
-      std::vector<int> B(K*M, 2);
-      std::vector<int> C(N*M);
-      for(size_t n=0; n<N; n++) {
-        for(size_t m=0; m<M; m++) {
-          int temp = 0;
-          for(size_t k=0; k<K; k++) {
-            temp += A[n*K + k] * B[k*M + m];
-          }
-          C[n*M + m] = temp;
+  // with chain compression a chain runs as one task, its members in chain order
+  if(_compress_chains) {
+    const ChainCompression& chains = compress_chains(_partition_size);
+    const FrozenGraph& cg = chains.graph;
+    std::vector<tf::Task> tasks(cg.num_nodes());
+    for(uint32_t s : cg.ids) {
+      tasks[s] = taskflow.emplace([this, matrix_size, &chains, s]() {
+        for(size_t i=chains.member_offsets[s]; i<chains.member_offsets[s+1]; i++) {
+          run_task(matrix_size, _store.cost[chains.members[i]]);
         }
+      });
+    }
+    for(uint32_t s : cg.ids) {
+      for(size_t e=cg.fanout_offsets[s]; e<cg.fanout_offsets[s+1]; e++) {
+        tasks[s].precede(tasks[cg.fanouts[e]]);
       }
-    });
+    }
   }
+  else {
+    for(auto node : _nodes) {
+      _store.task[node->_id] = taskflow.emplace([this, matrix_size, node]() {
+        run_task(matrix_size, _store.cost[node->_id]);
+      });
+    }
 
-  for(auto& node : _nodes) {
-    for(auto fanout : node._fanouts) {
-      node._task.precede(fanout->_to->_task);
+    const FrozenGraph& g = freeze();
+    for(uint32_t v : g.ids) {
+      for(size_t e=g.fanout_offsets[v]; e<g.fanout_offsets[v+1]; e++) {
+        _store.task[v].precede(_store.task[g.fanouts[e]]);
+      }
     }
   }
 
@@ -656,32 +3821,17 @@ void Graph::run_graph_after_partition(size_t matrix_size) {
   tf::Taskflow taskflow;
   tf::Executor executor;
 
-  for(auto& cnode : _cnodes) {
-    cnode._task = taskflow.emplace([&cnode, matrix_size]() {
-      for(size_t i=0; i<cnode._nodes.size(); i++) {
-        // std::this_thread::sleep_for(std::chrono::nanoseconds(task_runtime));
-        size_t N = matrix_size;
-        size_t M = matrix_size;
-        size_t K = matrix_size;
-        std::vector<int> A(N*K, 1);
-        std::vector<int> B(K*M, 2);
-        std::vector<int> C(N*M);
-        for(size_t n=0; n<N; n++) {
-          for(size_t m=0; m<M; m++) {
-            int temp = 0;
-            for(size_t k=0; k<K; k++) {
-              temp += A[n*K + k] * B[k*M + m];
-            }
-            C[n*M + m] = temp;
-          }
-        }
+  for(auto cnode : _cnodes) {
+    cnode->_task = taskflow.emplace([this, cnode, matrix_size]() {
+      for(auto node : cnode->_nodes) {
+        run_task(matrix_size, _store.cost[node->_id]);
       }
     });
   }
 
-  for(auto& cnode : _cnodes) {
-    for(auto fanout : cnode._fanouts) {
-      cnode._task.precede(fanout->_to->_task);
+  for(auto cnode : _cnodes) {
+    for(auto fanout : cnode->_fanouts) {
+      cnode->_task.precede(fanout->_to->_task);
     }
   }
 
@@ -696,14 +3846,32 @@ void Graph::run_graph_after_partition(size_t matrix_size) {
 
 void Graph::_get_topo_reverse_order_dfs(std::vector<Node*>& topo) { 
 
-  // reset
-  for(auto& node : _nodes) {
-    node._visited = false;
-  }
+  const FrozenGraph& g = freeze();
 
-  for(auto& node : _nodes) {
-    if(node._fanins.size() == 0) {
-      _topo_dfs(topo, &node);
+  // iterative version of _topo_dfs on the snapshot
+  // each stack entry is (node, offset of the next fanout to visit)
+  std::vector<char> visited(g.num_ids(), 0);
+  std::vector<std::pair<uint32_t, size_t>> stack;
+
+  for(uint32_t s : g.ids) {
+    if(g.num_fanins(s) != 0) {
+      continue;
+    }
+    visited[s] = 1;
+    stack.emplace_back(s, g.fanout_offsets[s]);
+    while(!stack.empty()) {
+      auto& [v, e] = stack.back();
+      if(e < g.fanout_offsets[v+1]) {
+        uint32_t successor = g.fanouts[e++];
+        if(!visited[successor]) {
+          visited[successor] = 1;
+          stack.emplace_back(successor, g.fanout_offsets[successor]);
+        }
+      }
+      else {
+        topo.push_back(g.nodes[v]);
+        stack.pop_back();
+      }
     }
   }
 
@@ -731,36 +3899,22 @@ void Graph::run_graph_semaphore(size_t matrix_size, size_t num_semaphore) {
 
   auto start_construct = std::chrono::steady_clock::now();
   if(_first_run) {
-    for(auto& node : _nodes) {
-      node._task = _taskflow.emplace([this, matrix_size, &node]() {
-        // std::this_thread::sleep_for(std::chrono::nanoseconds(task_runtime));
-        size_t N = matrix_size;
-        size_t M = matrix_size;
-        size_t K = matrix_size;
-        std::vector<int> A(N*K, 1);
-        std::vector<int> B(K*M, 2);
-        std::vector<int> C(N*M);
-        for(size_t n=0; n<N; n++) {
-          for(size_t m=0; m<M; m++) {
-            int temp = 0;
-            for(size_t k=0; k<K; k++) {
-              temp += A[n*K + k] * B[k*M + m];
-            }
-            C[n*M + m] = temp;
-          }
-        }
+    for(auto node : _nodes) {
+      _store.task[node->_id] = _taskflow.emplace([this, matrix_size, node]() {
+        run_task(matrix_size, _store.cost[node->_id]);
       });
     }
 
-    for(auto& node : _nodes) {
-      for(auto fanout : node._fanouts) {
-        node._task.precede(fanout->_to->_task);
+    const FrozenGraph& g = freeze();
+    for(uint32_t v : g.ids) {
+      for(size_t e=g.fanout_offsets[v]; e<g.fanout_offsets[v+1]; e++) {
+        _store.task[v].precede(_store.task[g.fanouts[e]]);
       }
     }
 
-    for(auto& node : _nodes) {
-      node._task.acquire(_semaphore);
-      node._task.release(_semaphore);
+    for(auto node : _nodes) {
+      _store.task[node->_id].acquire(_semaphore);
+      _store.task[node->_id].release(_semaphore);
     }
   }
   auto end_construct = std::chrono::steady_clock::now();
@@ -784,14 +3938,15 @@ void Graph::dump_graph() {
   tf::Executor executor;
 
   auto start = std::chrono::steady_clock::now();
-  for(auto& node : _nodes) {
-    node._task = taskflow.emplace([this]() {
-    }).name(node._name);
+  for(auto node : _nodes) {
+    _store.task[node->_id] = taskflow.emplace([this]() {
+    }).name(std::string(_store.name[node->_id]));
   }
 
-  for(auto& node : _nodes) {
-    for(auto fanout : node._fanouts) {
-      node._task.precede(fanout->_to->_task);
+  const FrozenGraph& g = freeze();
+  for(uint32_t v : g.ids) {
+    for(size_t e=g.fanout_offsets[v]; e<g.fanout_offsets[v+1]; e++) {
+      _store.task[v].precede(_store.task[g.fanouts[e]]);
     }
   }
 
@@ -800,33 +3955,36 @@ void Graph::dump_graph() {
 
 std::vector<Node*> Graph::_get_topo_order_bfs() {
 
-  std::vector<Node*> topo;
-
-  std::vector<int> indegrees(_nodes.size(), 0);
-  for(auto& node : _nodes) {
-    indegrees[node._id] = (int)node._fanins.size();
-  }
+  const FrozenGraph& g = freeze();
+  const size_t n = g.num_nodes();
 
-  std::queue<Node*> q;
-  for(auto& node : _nodes) {
-    if(node._fanins.size() == 0) {
-      node._level = 0;
-      q.push(&node);
+  std::vector<Node*> topo;
+  topo.reserve(n);
+
+  std::vector<int> indegrees(g.num_ids(), 0);
+  std::vector<int> levels(g.num_ids(), -1);
+  std::vector<uint32_t> q;
+  q.reserve(n);
+  for(uint32_t v : g.ids) {
+    indegrees[v] = (int)g.num_fanins(v);
+    if(indegrees[v] == 0) {
+      levels[v] = 0;
+      q.push_back(v);
     }
   }
 
-  while(!q.empty()) {
+  for(size_t head=0; head<q.size(); head++) {
     
-    Node* cur = q.front();
-    q.pop();
+    uint32_t cur = q[head];
 
-    topo.push_back(cur);
+    topo.push_back(g.nodes[cur]);
+    _store.level[cur] = levels[cur];
 
-    for(auto fanout : cur->_fanouts) {
-      Node* fanout_node = fanout->_to;
-      if(--indegrees[fanout_node->_id] == 0) {
-        fanout_node->_level = ++cur->_level;
-        q.push(fanout_node);
+    for(size_t e=g.fanout_offsets[cur]; e<g.fanout_offsets[cur+1]; e++) {
+      uint32_t fanout_node = g.fanouts[e];
+      levels[fanout_node] = std::max(levels[fanout_node], levels[cur] + 1);
+      if(--indegrees[fanout_node] == 0) {
+        q.push_back(fanout_node);
       }
     }
   }
@@ -842,7 +4000,7 @@ void Graph::test_func() {
   // for(auto level : level_list) {
   //   std::cout << "level " << level_id << ": ";
   //   for(auto node_ptr : level) {
-  //     std::cout << node_ptr->_name << "(" << node_ptr->_lid << ") ";
+  //     std::cout << _store.name[node_ptr->_id] << "(" << _store.lid[node_ptr->_id] << ") ";
   //   }
   //   std::cout << "\n";
   // }
@@ -852,44 +4010,105 @@ void Graph::test_func() {
 
 std::vector<std::vector<Node*>> Graph::_get_level_list() {
 
+  if(_compress_chains) {
+    return _get_chain_level_list();
+  }
+
   std::vector<std::vector<Node*>> level_list;
 
-  std::vector<int> indegrees(_nodes.size(), 0);
-  for(auto& node : _nodes) {
-    indegrees[node._id] = node._fanins.size();
-  }
+  const FrozenGraph& g = freeze();
+  const size_t n = g.num_nodes();
 
-  std::queue<Node*> q;
-  for(auto& node : _nodes) {
-    if(node._fanins.size() == 0) {
-      q.push(&node);
+  std::vector<size_t> indegrees(g.num_ids());
+  std::vector<uint32_t> q; // nodes of one level are contiguous in q
+  q.reserve(n);
+  for(uint32_t v : g.ids) {
+    indegrees[v] = g.num_fanins(v);
+    if(indegrees[v] == 0) {
+      q.push_back(v);
     }
   }
 
   size_t visited = 0;
 
-  while(!q.empty()) {
+  while(visited < q.size()) {
     
-    int level_length = static_cast<int>(q.size());
+    size_t level_end = q.size();
     level_list.emplace_back();
-    level_list.back().reserve(level_length);
+    level_list.back().reserve(level_end - visited);
 
-    for(int i = 0; i < level_length; i++) {
-      Node* cur = q.front(); q.pop();
-      cur->_lid = static_cast<int>(level_list.back().size());
+    for(; visited < level_end; visited++) {
+      uint32_t v = q[visited];
+      Node* cur = g.nodes[v];
+      _store.lid[v] = static_cast<int>(level_list.back().size());
       level_list.back().push_back(cur); 
-      cur->_topo_id = visited++;
+      _store.topo_id[v] = static_cast<int>(visited);
+
+      for(size_t e=g.fanout_offsets[v]; e<g.fanout_offsets[v+1]; e++) {
+        if(--indegrees[g.fanouts[e]] == 0) {
+          q.push_back(g.fanouts[e]);
+        }
+      }
+    }
+  }
+
+  if(visited != n) {
+    throw std::runtime_error("The DAG has a cycle");
+  }
+
+  return level_list;
+}
+
+std::vector<std::vector<Node*>> Graph::_get_chain_level_list() {
+
+  /*
+   * levels of the supernodes, with every chain expanded in place: all members of a chain
+   * share its level and its lid (so its stream), and come one after another in chain
+   * order, which keeps the list, read level by level, a topological order of the nodes
+   */
+  std::vector<std::vector<Node*>> level_list;
+
+  const ChainCompression& chains = compress_chains(_partition_size);
+  const FrozenGraph& g = chains.graph;
+  const size_t n = g.num_nodes();
+
+  std::vector<size_t> indegrees(n);
+  std::vector<uint32_t> q;
+  q.reserve(n);
+  for(uint32_t s : g.ids) {
+    indegrees[s] = g.num_fanins(s);
+    if(indegrees[s] == 0) {
+      q.push_back(s);
+    }
+  }
+
+  size_t visited = 0;
+  int topo_id = 0;
+
+  while(visited < q.size()) {
+
+    size_t level_end = q.size();
+    level_list.emplace_back();
+
+    for(int lid=0; visited < level_end; visited++, lid++) {
+      uint32_t s = q[visited];
+      for(size_t i=chains.member_offsets[s]; i<chains.member_offsets[s+1]; i++) {
+        uint32_t v = chains.members[i];
+        _store.lid[v] = lid;
+        _store.topo_id[v] = topo_id++;
+        level_list.back().push_back(_store.node[v]);
+      }
 
-      for(auto fanout : cur->_fanouts) {
-        Node* fanout_node = fanout->_to;
-        if(--indegrees[fanout_node->_id] == 0) {
-          q.push(fanout_node);
+      for(size_t e=g.fanout_offsets[s]; e<g.fanout_offsets[s+1]; e++) {
+        if(--indegrees[g.fanouts[e]] == 0) {
+          q.push_back(g.fanouts[e]);
         }
       }
     }
   }
 
-  if(visited != _nodes.size()) {
+  // compress_chains throws on cycles through chains only
+  if(visited != n) {
     throw std::runtime_error("The DAG has a cycle");
   }
 
@@ -899,15 +4118,15 @@ std::vector<std::vector<Node*>> Graph::_get_level_list() {
 void Graph::partition_cudaflow(size_t num_streams) {
 
   // TODO: instead of reset the reconstructed graph, do it incrementally
-  int id = 0;
-  for(auto& node : _nodes) {
-    node._id = id++;
-    node._topo_id = -1;
-    node._level = -1;
-    node._lid = -1;
-    node._sm = -1;
-    node._reconstructed_fanins.clear();
-    node._reconstructed_fanouts.clear();
+  const FrozenGraph& g = freeze();
+  for(uint32_t v : g.ids) {
+    Node* node = g.nodes[v];
+    _store.topo_id[v] = -1;
+    _store.level[v] = -1;
+    _store.lid[v] = -1;
+    _store.sm[v] = -1;
+    node->_reconstructed_fanins.clear();
+    node->_reconstructed_fanouts.clear();
   }
 
   // get level list 
@@ -920,14 +4139,14 @@ void Graph::partition_cudaflow(size_t num_streams) {
   auto start = std::chrono::steady_clock::now();
   for(auto& level : level_list) {
     for(auto node : level) {
-      int stream_id_cur = (node->_lid) % num_streams; 
+      int stream_id_cur = (_store.lid[node->_id]) % num_streams; 
       Node* last_assign = NULL; // "last" predecessor in the same stream 
                                 // stream_id_prev to build dependency edge
-      for(auto fanin : node->_fanins) {
-        Node* predecessor = fanin->_from; 
-        int stream_id_prev = (predecessor->_lid) % num_streams;
-        if(stream_id_prev == node->_sm) {
-          if(!last_assign || (last_assign && last_assign->_topo_id < predecessor->_topo_id)) {
+      for(size_t e=g.fanin_offsets[node->_id]; e<g.fanin_offsets[node->_id+1]; e++) {
+        Node* predecessor = g.nodes[g.fanins[e]]; 
+        int stream_id_prev = (_store.lid[predecessor->_id]) % num_streams;
+        if(stream_id_prev == _store.sm[node->_id]) {
+          if(!last_assign || (last_assign && _store.topo_id[last_assign->_id] < _store.topo_id[predecessor->_id])) {
             last_assign = predecessor;
           }
         }
@@ -941,11 +4160,11 @@ void Graph::partition_cudaflow(size_t num_streams) {
         node->_reconstructed_fanins.push_back(last_assign);
       }
       streams[stream_id_cur].push_back(node);
-      for(auto fanout : node->_fanouts) {
-        Node* successor = fanout->_to;
-        int stream_id_suc = (successor->_lid) % num_streams;
+      for(size_t e=g.fanout_offsets[node->_id]; e<g.fanout_offsets[node->_id+1]; e++) {
+        Node* successor = g.nodes[g.fanouts[e]];
+        int stream_id_suc = (_store.lid[successor->_id]) % num_streams;
         if(stream_id_suc != stream_id_cur) {
-          successor->_sm = stream_id_cur;
+          _store.sm[successor->_id] = stream_id_cur;
         }
       }
     }
@@ -966,6 +4185,9 @@ void Graph::partition_cudaflow(size_t num_streams) {
   size_t partition_runtime = std::chrono::duration_cast<std::chrono::microseconds>(end-start).count();
   _incre_partition_runtime_with_cudaflow_partition += partition_runtime;
 
+  _num_streams = num_streams;
+  _incremental_streams = false;
+
   // if(!is_cudaflow_partition_share_same_topo_order()) {
   //   throw std::runtime_error("they do not share same topological order.\n");
   // }
@@ -976,14 +4198,14 @@ void Graph::partition_cudaflow(size_t num_streams) {
   tf::Executor executor;
 
   auto start = std::chrono::steady_clock::now();
-  for(auto& node : _nodes) {
-    node._task = taskflow.emplace([this]() {
-    }).name(node._name);
+  for(auto node : _nodes) {
+    _store.task[node->_id] = taskflow.emplace([this]() {
+    }).name(std::string(_store.name[node->_id]));
   }
 
-  for(auto& node : _nodes) {
-    for(auto successor : node._reconstructed_fanouts) {
-      node._task.precede(successor->_task);
+  for(auto node : _nodes) {
+    for(auto successor : node->_reconstructed_fanouts) {
+      _store.task[node->_id].precede(_store.task[successor->_id]);
     }
   }
 
@@ -993,53 +4215,44 @@ void Graph::partition_cudaflow(size_t num_streams) {
 
 bool Graph::is_cudaflow_partition_share_same_topo_order() {
 
-  // store the union graph of two DAGs as adjacent list
-  std::vector<std::vector<int>> adj(_nodes.size());
-  std::vector<int> indegrees(_nodes.size(), 0);
-
-  // add original DAG to adj
-  for(auto& node : _nodes) {
-    indegrees[node._id] = node._fanins.size();
-    for(auto fanout : node._fanouts) {
-      Node* fanout_node = fanout->_to;
-      adj[node._id].push_back(fanout_node->_id);
-    }
-  }
+  const FrozenGraph& g = freeze();
+  const size_t n = g.num_nodes();
 
-  // add cudaflow partitioned DAG to adj
-  // here we increment the indegrees and add more edges
+  // the union graph of two DAGs is the original DAG (CSR snapshot)
+  // plus the cudaflow partitioned DAG (_reconstructed_fanins/fanouts)
   // there could be duplicate edges in union graph
   // but the topological sort can handle this
-  for(auto& node : _nodes) {
-    indegrees[node._id] += node._reconstructed_fanins.size();
-    for(auto fanout_node : node._reconstructed_fanouts) {
-      adj[node._id].push_back(fanout_node->_id);
-    }
+  std::vector<size_t> indegrees(g.num_ids());
+  for(uint32_t v : g.ids) {
+    indegrees[v] = g.num_fanins(v) + g.nodes[v]->_reconstructed_fanins.size();
   }
 
   // run topological sort to check if union graph is acyclic
-  std::queue<int> q;
-  for(int i = 0; i < static_cast<int>(_nodes.size()); i++) {
-    if(indegrees[i] == 0) {
-      q.push(i);
+  std::vector<uint32_t> q;
+  q.reserve(n);
+  for(uint32_t v : g.ids) {
+    if(indegrees[v] == 0) {
+      q.push_back(v);
     }
   }
 
-  size_t visited = 0;
-  while(!q.empty()) {
+  for(size_t head=0; head<q.size(); head++) {
     
-    int cur = q.front();
-    q.pop();
-    visited++;
+    uint32_t cur = q[head];
 
-    for(int successor : adj[cur]) {
-      if(--indegrees[successor] == 0) {
-        q.push(successor);
+    for(size_t e=g.fanout_offsets[cur]; e<g.fanout_offsets[cur+1]; e++) {
+      if(--indegrees[g.fanouts[e]] == 0) {
+        q.push_back(g.fanouts[e]);
+      }
+    }
+    for(auto fanout_node : g.nodes[cur]->_reconstructed_fanouts) {
+      if(--indegrees[fanout_node->_id] == 0) {
+        q.push_back(fanout_node->_id);
       }
     }
   }
 
-  return (visited == _nodes.size());
+  return (q.size() == n);
 }
 
 void Graph::run_graph_cudaflow_partition(size_t matrix_size, size_t num_streams) { // num_streams = max_parallelism
@@ -1049,30 +4262,15 @@ void Graph::run_graph_cudaflow_partition(size_t matrix_size, size_t num_streams)
   _taskflow.clear();
 
   auto start1 = std::chrono::steady_clock::now();
-  for(auto& node : _nodes) {
-    node._task = _taskflow.emplace([this, matrix_size, &node]() {
-      // std::this_thread::sleep_for(std::chrono::nanoseconds(task_runtime));
-      size_t N = matrix_size;
-      size_t M = matrix_size;
-      size_t K = matrix_size;
-      std::vector<int> A(N*K, 1);
-      std::vector<int> B(K*M, 2);
-      std::vector<int> C(N*M);
-      for(size_t n=0; n<N; n++) {
-        for(size_t m=0; m<M; m++) {
-          int temp = 0;
-          for(size_t k=0; k<K; k++) {
-            temp += A[n*K + k] * B[k*M + m];
-          }
-          C[n*M + m] = temp;
-        }
-      }
+  for(auto node : _nodes) {
+    _store.task[node->_id] = _taskflow.emplace([this, matrix_size, node]() {
+      run_task(matrix_size, _store.cost[node->_id]);
     });
   }
 
-  for(auto& node : _nodes) {
-    for(auto fanout_node : node._reconstructed_fanouts) {
-      node._task.precede(fanout_node->_task);
+  for(auto node : _nodes) {
+    for(auto fanout_node : node->_reconstructed_fanouts) {
+      _store.task[node->_id].precede(_store.task[fanout_node->_id]);
     }
   }
   auto end1 = std::chrono::steady_clock::now();
@@ -1095,34 +4293,20 @@ void Graph::run_graph_cudaflow_partition_incremental(size_t matrix_size, size_t
     _taskflow.clear();
 
     auto start1 = std::chrono::steady_clock::now();
-    for(auto& node : _nodes) {
-      node._task = _taskflow.emplace([this, matrix_size, &node]() {
-        // std::this_thread::sleep_for(std::chrono::nanoseconds(task_runtime));
-        size_t N = matrix_size;
-        size_t M = matrix_size;
-        size_t K = matrix_size;
-        std::vector<int> A(N*K, 1);
-        std::vector<int> B(K*M, 2);
-        std::vector<int> C(N*M);
-        for(size_t n=0; n<N; n++) {
-          for(size_t m=0; m<M; m++) {
-            int temp = 0;
-            for(size_t k=0; k<K; k++) {
-              temp += A[n*K + k] * B[k*M + m];
-            }
-            C[n*M + m] = temp;
-          }
-        }
+    for(auto node : _nodes) {
+      _store.task[node->_id] = _taskflow.emplace([this, matrix_size, node]() {
+        run_task(matrix_size, _store.cost[node->_id]);
       });
     }
 
-    for(auto& node : _nodes) {
-      for(auto fanout : node._fanouts) {
-        node._task.precede(fanout->_to->_task);
+    const FrozenGraph& g = freeze();
+    for(uint32_t v : g.ids) {
+      for(size_t e=g.fanout_offsets[v]; e<g.fanout_offsets[v+1]; e++) {
+        _store.task[v].precede(_store.task[g.fanouts[e]]);
       }
       // add extra dependency from partitioning to limit max parallelism
-      if(node._extra_fanout) {
-        node._task.precede(node._extra_fanout->_task);
+      if(g.nodes[v]->_extra_fanout) {
+        _store.task[v].precede(_store.task[g.nodes[v]->_extra_fanout->_id]);
       }
     }
     auto end1 = std::chrono::steady_clock::now();
@@ -1143,14 +4327,16 @@ void Graph::run_graph_cudaflow_partition_incremental(size_t matrix_size, size_t
 void Graph::partition_cudaflow_incremental(size_t num_streams) {
 
   // TODO: instead of reset the reconstructed graph, do it incrementally
-  int id = 0;
-  for(auto& node : _nodes) {
-    node._id = id++;
-    node._topo_id = -1;
-    node._level = -1;
-    node._lid = -1;
-    node._extra_fanin = nullptr;
-    node._extra_fanout = nullptr;
+  const FrozenGraph& g = freeze();
+  for(uint32_t v : g.ids) {
+    Node* node = g.nodes[v];
+    _store.topo_id[v] = -1;
+    _store.level[v] = -1;
+    _store.lid[v] = -1;
+    node->_reconstructed_fanins.clear();
+    node->_reconstructed_fanouts.clear();
+    node->_extra_fanin = nullptr;
+    node->_extra_fanout = nullptr;
   }
 
   // get level list 
@@ -1163,7 +4349,7 @@ void Graph::partition_cudaflow_incremental(size_t num_streams) {
   auto start = std::chrono::steady_clock::now();
   for(auto& level : level_list) {
     for(auto node : level) {
-      int stream_id_cur = (node->_lid) % num_streams; 
+      int stream_id_cur = (_store.lid[node->_id]) % num_streams; 
       streams[stream_id_cur].push_back(node);
     }
   }
@@ -1184,67 +4370,249 @@ void Graph::partition_cudaflow_incremental(size_t num_streams) {
   auto end = std::chrono::steady_clock::now();
   size_t partition_runtime = std::chrono::duration_cast<std::chrono::microseconds>(end-start).count();
   _incre_partition_runtime_with_cudaflow_partition += partition_runtime;
+
+  _num_streams = num_streams;
+  _incremental_streams = true;
 }
 
 bool Graph::is_incre_cudaflow_partition_share_same_topo_order() {
 
-  // store the union graph of two DAGs as adjacent list
-  std::vector<std::vector<int>> adj(_nodes.size());
-  std::vector<int> indegrees(_nodes.size(), 0);
+  const FrozenGraph& g = freeze();
+  const size_t n = g.num_nodes();
 
-  // add original DAG to adj
-  for(auto& node : _nodes) {
-    indegrees[node._id] = node._fanins.size();
-    for(auto fanout : node._fanouts) {
-      Node* fanout_node = fanout->_to;
-      adj[node._id].push_back(fanout_node->_id);
+  // the union graph of two DAGs is the original DAG (CSR snapshot)
+  // plus one extra fanin/fanout per node added by incremental cudaflow partitioning
+  std::vector<size_t> indegrees(g.num_ids());
+  for(uint32_t v : g.ids) {
+    indegrees[v] = g.num_fanins(v);
+    // the first node in the stream does not have extra fanin
+    if(g.nodes[v]->_extra_fanin) {
+      indegrees[v] += 1;
     }
   }
 
-  // add cudaflow partitioned DAG to adj
-  // here we increment the indegrees and add more edges
-  // there could be duplicate edges in union graph
-  // but the topological sort can handle this
-  for(auto& node : _nodes) {
-    indegrees[node._id] += node._fanins.size();
-    // the first node in the stream does not have extra fanin
-    if(node._extra_fanin) {
-      indegrees[node._id] += 1; // one extra fanin added by incremental cudaflow partitioning
+  // run topological sort to check if union graph is acyclic
+  std::vector<uint32_t> q;
+  q.reserve(n);
+  for(uint32_t v : g.ids) {
+    if(indegrees[v] == 0) {
+      q.push_back(v);
     }
-    for(auto fanout : node._fanouts) {
-      Node* fanout_node = fanout->_to;
-      adj[node._id].push_back(fanout_node->_id);
+  }
+
+  for(size_t head=0; head<q.size(); head++) {
+    
+    uint32_t cur = q[head];
+
+    for(size_t e=g.fanout_offsets[cur]; e<g.fanout_offsets[cur+1]; e++) {
+      if(--indegrees[g.fanouts[e]] == 0) {
+        q.push_back(g.fanouts[e]);
+      }
     }
     // the last node in the stream does not have extra fanout
-    if(node._extra_fanout) {
-      adj[node._id].push_back(node._extra_fanout->_id); // one extra fanout added by incremental 
-                                                        // cudaflow partitioning
+    Node* extra_fanout = g.nodes[cur]->_extra_fanout;
+    if(extra_fanout && --indegrees[extra_fanout->_id] == 0) {
+      q.push_back(extra_fanout->_id);
     }
   }
 
-  // run topological sort to check if union graph is acyclic
-  std::queue<int> q;
-  for(int i = 0; i < static_cast<int>(_nodes.size()); i++) {
-    if(indegrees[i] == 0) {
-      q.push(i);
+  return (q.size() == n);
+}
+
+ChangelogReader::ChangelogReader(const std::string& path) : _file {path} {
+  std::string_view data = _file.view();
+  _cur = data.data();
+  _end = data.data() + data.size();
+  if(data.substr(0, sizeof(ChangelogMagic)) == std::string_view(ChangelogMagic, sizeof(ChangelogMagic))) {
+    if(data.size() < sizeof(ChangelogMagic) + 2 * sizeof(uint32_t)) {
+      throw std::runtime_error("truncated changelog header");
     }
+    uint32_t version;
+    std::memcpy(&version, _cur + sizeof(ChangelogMagic), sizeof(version));
+    if(version != ChangelogVersion) {
+      throw std::runtime_error("unsupported changelog version " + std::to_string(version));
+    }
+    _cur += sizeof(ChangelogMagic) + 2 * sizeof(uint32_t);
+    _binary = true;
+  }
+}
+
+bool ChangelogReader::next(ChangeBatch& batch) {
+  batch.clear();
+  bool more = _binary ? _next_binary(batch) : _next_text(batch);
+  if(more) {
+    ++_num_batches;
   }
+  return more;
+}
 
-  size_t visited = 0;
-  while(!q.empty()) {
-    
-    int cur = q.front();
-    q.pop();
-    visited++;
+bool ChangelogReader::_next_text(ChangeBatch& batch) {
+
+  TextCursor in {_cur, _end};
+  if(in.eof()) {
+    return false;
+  }
+
+  auto fail = [this](const char* what) {
+    throw std::runtime_error("changelog batch " + std::to_string(_num_batches) + ": " + what);
+  };
+
+  if(!in.literal("batch") || !in.literal(";")) {
+    fail("expected \"batch;\"");
+  }
+
+  // records up to the next "batch;" or the end of the file
+  while(!in.eof() && *in.cur != 'b') {
+    bool insert = in.literal("+");
+    if(!insert && !in.literal("-")) {
+      fail("a record must start with + or -");
+    }
+    std::string_view from, to;
+    if(!in.quoted(from)) {
+      fail("malformed node name");
+    }
+    bool edge = in.literal("->");
+    if(edge && !in.quoted(to)) {
+      fail("malformed node name");
+    }
+    if(!in.literal(";")) {
+      fail("missing ;");
+    }
+    if(edge) {
+      (insert ? batch.insert_edges : batch.remove_edges).emplace_back(from, to);
+    }
+    else {
+      (insert ? batch.insert_nodes : batch.remove_nodes).push_back(from);
+    }
+  }
+
+  _cur = in.cur;
+  return true;
+}
+
+bool ChangelogReader::_next_binary(ChangeBatch& batch) {
+
+  if(_cur == _end) {
+    return false;
+  }
+
+  uint64_t num_records = get_varint(_cur, _end);
+  for(uint64_t k=0; k<num_records; k++) {
+    if(_cur == _end) {
+      throw std::runtime_error("truncated changelog record");
+    }
+    switch(static_cast<uint8_t>(*_cur++)) {
+      case ChangelogRemoveEdge: {
+        std::string_view from = get_name(_cur, _end);
+        batch.remove_edges.emplace_back(from, get_name(_cur, _end));
+        break;
+      }
+      case ChangelogRemoveNode:
+        batch.remove_nodes.push_back(get_name(_cur, _end));
+        break;
+      case ChangelogInsertNode:
+        batch.insert_nodes.push_back(get_name(_cur, _end));
+        break;
+      case ChangelogInsertEdge: {
+        std::string_view from = get_name(_cur, _end);
+        batch.insert_edges.emplace_back(from, get_name(_cur, _end));
+        break;
+      }
+      default:
+        throw std::runtime_error("unknown changelog op");
+    }
+  }
 
-    for(int successor : adj[cur]) {
-      if(--indegrees[successor] == 0) {
-        q.push(successor);
+  return true;
+}
+
+ChangelogWriter::ChangelogWriter(const std::string& path, bool binary) :
+  _out {path, std::ios::binary}, _binary {binary}, _path {path} {
+  if(_binary) {
+    uint32_t version_flags[2] = {ChangelogVersion, 0};
+    _out.write(ChangelogMagic, sizeof(ChangelogMagic));
+    _out.write(reinterpret_cast<const char*>(version_flags), sizeof(version_flags));
+  }
+  if(!_out) {
+    throw std::runtime_error("cannot write " + _path);
+  }
+}
+
+void ChangelogWriter::write(const ChangeBatch& batch) {
+
+  _buf.clear();
+
+  if(_binary) {
+    auto put_name = [this](std::string_view name) {
+      put_varint(_buf, name.size());
+      _buf.insert(_buf.end(), name.begin(), name.end());
+    };
+    put_varint(_buf, batch.remove_edges.size() + batch.remove_nodes.size() +
+                     batch.insert_nodes.size() + batch.insert_edges.size());
+    for(auto [from, to] : batch.remove_edges) {
+      _buf.push_back(ChangelogRemoveEdge);
+      put_name(from);
+      put_name(to);
+    }
+    for(auto name : batch.remove_nodes) {
+      _buf.push_back(ChangelogRemoveNode);
+      put_name(name);
+    }
+    for(auto name : batch.insert_nodes) {
+      _buf.push_back(ChangelogInsertNode);
+      put_name(name);
+    }
+    for(auto [from, to] : batch.insert_edges) {
+      _buf.push_back(ChangelogInsertEdge);
+      put_name(from);
+      put_name(to);
+    }
+  }
+  else {
+    auto put = [this](std::string_view s) {
+      _buf.insert(_buf.end(), s.begin(), s.end());
+    };
+    // the text format has no escapes, so a name must not end its quotes or its line
+    auto put_name = [this, &put](std::string_view name) {
+      if(name.find_first_of("\"\n") != std::string_view::npos) {
+        throw std::runtime_error("node name \"" + std::string(name) + "\" cannot be written to the " +
+                                 "text changelog " + _path + ", use the binary format");
       }
+      put(" \"");
+      put(name);
+      put("\"");
+    };
+    auto put_node = [&put, &put_name](std::string_view op, std::string_view name) {
+      put(op);
+      put_name(name);
+      put(";\n");
+    };
+    auto put_edge = [&put, &put_name](std::string_view op, std::string_view from, std::string_view to) {
+      put(op);
+      put_name(from);
+      put(" ->");
+      put_name(to);
+      put(";\n");
+    };
+    put("batch;\n");
+    for(auto [from, to] : batch.remove_edges) {
+      put_edge("-", from, to);
+    }
+    for(auto name : batch.remove_nodes) {
+      put_node("-", name);
+    }
+    for(auto name : batch.insert_nodes) {
+      put_node("+", name);
+    }
+    for(auto [from, to] : batch.insert_edges) {
+      put_edge("+", from, to);
     }
   }
 
-  return (visited == _nodes.size());
+  _out.write(_buf.data(), _buf.size());
+  if(!_out) {
+    throw std::runtime_error("cannot write " + _path);
+  }
 }
 
 } // end of namespace pasta
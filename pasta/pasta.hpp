@@ -1,11 +1,27 @@
 #pragma once
 
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <numeric>
 #include <iostream>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 #include <list>
+#include <map>
 #include <random>
 #include "taskflow/taskflow.hpp"
 #include "wsq.hpp"
+#include "pool.hpp"
+#include "small_vector.hpp"
+#include "edge_index.hpp"
+#include "name_table.hpp"
+#include "mapped_file.hpp"
 
 namespace pasta {
 
@@ -16,64 +32,188 @@ enum class RunMode {
   Partition
 };
 
+// how partition_c_pasta picks the cluster of a node; either way a node joins a cluster
+// no smaller than those of its fanins or a new one, which keeps the cluster graph acyclic
+enum class CPastaStrategy {
+  Greedy,       // join the largest fanin cluster whenever it has room
+  CriticalPath  // nodes on or near the critical path join it only to continue the critical
+                // path of a fanin, so their clusters are paths; the other nodes join greedily
+                // but never a cluster of critical nodes, which they would only delay
+};
+
+// which side of the roots a cone-restricted load keeps
+enum class ConeDirection {
+  Fanin,  // nodes that reach a root
+  Fanout  // nodes reachable from a root
+};
+
 class Node;
 class Edge;
 class CNode;
 class CEdge;
 class Graph;
 
-class Node {
-
-  friend class Graph;
-
-  public:
-    Node(const std::string& name) : _name(name) {};
+/*
+ * handle of a node/edge: the slot index of the object in its pool
+ * plus the generation of that slot when the handle was created.
+ * pool slots never move, so a handle stays valid until its object is removed;
+ * the generation tells a stale handle apart from the object that reuses the slot.
+ * (the node id Node::_id that indexes per-node arrays is a separate number
+ * which Graph::compact may change.)
+ */
+template <typename T>
+struct Handle {
+  uint32_t index = std::numeric_limits<uint32_t>::max();
+  uint32_t generation = 0;
+
+  bool operator == (const Handle&) const = default;
+};
 
-    inline size_t num_fanins() const {
-      return _fanins.size();
+using NodeId = Handle<Node>;
+using EdgeId = Handle<Edge>;
+
+// most nodes have fewer than 4 fanins/fanouts, so adjacency is stored inline
+// and only high-degree nodes spill to the heap
+using EdgeList = SmallVector<Edge*, 4>;
+
+/*
+ * structure-of-arrays store of per-node attributes, indexed by node id (Node::_id).
+ * attributes touched by traversals and partitioners sit in their own contiguous arrays,
+ * so a pass only pulls in the arrays it needs; names and taskflow handles are cold
+ * and kept in side tables. names are interned in a NameTable that also maps a name back to its id.
+ * ids are handed out by acquire() and recycled through a free list, so the id space
+ * never exceeds the peak number of nodes; permute() renumbers the live ids densely.
+ */
+struct NodeStore {
+
+  // hot
+  std::vector<EdgeList> fanins;
+  std::vector<EdgeList> fanouts;
+  std::vector<int> cluster_id; // specify which partition (cluster) it belongs
+  std::vector<int> topo_id; // idx in topological order
+  std::vector<int> level;
+  std::vector<int> lid; // indicate its index within its level
+  std::vector<int> sm; // stream assigned by the last predecessor in cudaflow partition
+  std::vector<uint32_t> cost; // work of the node in arbitrary units, see Graph::set_cost
+
+  // cold
+  NameTable name;
+  std::vector<tf::Task> task;
+  std::vector<Node*> node; // id -> node, nullptr for free ids
+
+  std::vector<uint32_t> free_ids;
+
+  inline size_t size() const {
+    return cluster_id.size();
+  }
+
+  void resize(size_t n) {
+    fanins.resize(n);
+    fanouts.resize(n);
+    cluster_id.resize(n, -1);
+    topo_id.resize(n, -1);
+    level.resize(n, -1);
+    lid.resize(n, -1);
+    sm.resize(n, -1);
+    cost.resize(n, 1);
+    name.resize(n);
+    task.resize(n);
+    node.resize(n, nullptr);
+  }
+
+  void reserve(size_t n) {
+    fanins.reserve(n);
+    fanouts.reserve(n);
+    cluster_id.reserve(n);
+    topo_id.reserve(n);
+    level.reserve(n);
+    lid.reserve(n);
+    sm.reserve(n);
+    cost.reserve(n);
+    task.reserve(n);
+    node.reserve(n);
+  }
+
+  // hand out an id for a new node
+  uint32_t acquire(Node* n) {
+    uint32_t id;
+    if(free_ids.empty()) {
+      id = static_cast<uint32_t>(size());
+      resize(id + 1);
     }
-
-    inline size_t num_fanouts() const {
-      return _fanouts.size();
+    else {
+      id = free_ids.back();
+      free_ids.pop_back();
     }
-
-    inline std::string name() {
-      return _name;
+    node[id] = n;
+    return id;
+  }
+
+  // reset the attributes of a freed id and recycle it
+  // adjacency vectors keep their capacity for the next node that gets this id
+  void release(uint32_t id) {
+    fanins[id].clear();
+    fanouts[id].clear();
+    cluster_id[id] = -1;
+    topo_id[id] = -1;
+    level[id] = -1;
+    lid[id] = -1;
+    sm[id] = -1;
+    cost[id] = 1;
+    name.erase(id);
+    task[id] = tf::Task();
+    node[id] = nullptr;
+    free_ids.push_back(id);
+  }
+
+  // renumber the live ids: new id i takes the attributes of old id order[i]
+  // ids not listed in order are dropped, and the store shrinks to order.size()
+  void permute(const std::vector<uint32_t>& order) {
+    auto gather = [&order](auto& attr) {
+      std::remove_reference_t<decltype(attr)> permuted;
+      permuted.reserve(order.size());
+      for(uint32_t id : order) {
+        permuted.push_back(std::move(attr[id]));
+      }
+      attr.swap(permuted);
+    };
+    gather(fanins);
+    gather(fanouts);
+    gather(cluster_id);
+    gather(topo_id);
+    gather(level);
+    gather(lid);
+    gather(sm);
+    gather(cost);
+    gather(task);
+    gather(node);
+
+    // re-interning also drops the dead bytes of the name arena
+    NameTable names;
+    names.resize(order.size());
+    for(uint32_t i=0; i<order.size(); i++) {
+      names.set(i, name[order[i]]);
     }
+    name = std::move(names);
 
-  private:
-    std::string _name;  
-
-    bool _have_acquired_semaphore = false;
+    free_ids.clear();
+  }
+};
 
-    int _id = -1;
+/*
+ * a node only keeps its identity and the cold per-node data of the cudaflow partitioners,
+ * everything else lives in Graph::_store indexed by _id.
+ */
+class Node {
 
-    /*
-     * fanouts should not only include which fanout edges this node has(_fanouts)
-     * but also the index of this edge in the fanin edge list of its fanout nodes(_fanout_satellites).
-     * so when removing the node, we just need to traverse the _fanout_satellites once and erase the
-     * edge of this node from the fanin edge list of fanout nodes.
-     * similar method applied to fanins.
-     */
-    std::list<Edge*> _fanins;
-    std::list<Edge*> _fanouts;
-    std::list<std::pair<Node*, std::list<Edge*>::iterator>> _fanout_satellites;
-    std::list<std::pair<Node*, std::list<Edge*>::iterator>> _fanin_satellites;
+  friend class Graph;
 
-    std::list<Node>::iterator _node_satellite;
-    std::list<CNode>::iterator _cnode_satellite;
+  private:
+    int _id = -1; // index in Graph::_store, changed by Graph::compact
 
-    bool _visited = false;
-    tf::Task _task;
-    int _cluster_id = -1; // specify which partition (cluster) it belongs
-    std::atomic<size_t> _dep_cnt{0};
-    CNode* _cnode = NULL; // specify which cnode (cluster) it belongs
+    size_t _node_satellite; // index in Graph::_nodes
 
     // used in cudaflow reconstructed graph
-    int _topo_id = -1; // idx in topological order
-    int _level = -1;
-    int _lid = -1; // indicate its index within its level 
-    int _sm = -1;
     std::vector<Node*> _reconstructed_fanins;
     std::vector<Node*> _reconstructed_fanouts;
 
@@ -81,8 +221,8 @@ class Node {
     // Use cudaflow partitioning to add
     // just one extra fanin/fanout to limit the maximum parallelism
     // the other dependencies follow the original graph
-    Node* _extra_fanin;
-    Node* _extra_fanout;
+    Node* _extra_fanin = nullptr;
+    Node* _extra_fanout = nullptr;
 
 };
 
@@ -94,10 +234,15 @@ class Edge {
     Node* _from;
     Node* _to;
 
-    std::list<Edge*>::iterator _from_satellite; // edge satellite in from node _fanouts
-    std::list<Edge*>::iterator _to_satellite; // edge satellite in to node _fanins
+    /*
+     * position of this edge in the fanouts of from node and the fanins of to node.
+     * removal swaps the last entry into that position and patches its position,
+     * so removing an edge is O(1) and removing a node is O(1) per incident edge.
+     */
+    size_t _from_pos;
+    size_t _to_pos;
 
-    std::list<Edge>::iterator _satellite;
+    size_t _satellite; // index in Graph::_edges
 
 };
 
@@ -106,12 +251,13 @@ class CNode {
   friend class Graph;
 
   private:
+    int _id = -1; // index in Graph::_cnodes, which is its cluster id
     bool _visited = false;
     tf::Task _task;
-    std::list<Node*> _nodes;
-    std::list<CEdge*> _fanins;
-    std::list<CEdge*> _fanouts;
-    std::list<CNode>::iterator _satellite;
+    // vectors keep their capacity when a cnode is reused by the next partition
+    std::vector<Node*> _nodes;
+    std::vector<CEdge*> _fanins;
+    std::vector<CEdge*> _fanouts;
 
 };
 
@@ -122,22 +268,300 @@ class CEdge {
   private:
     CNode* _from;
     CNode* _to;
-    std::list<CEdge>::iterator _satellite;
 
+    // used by incremental C-PASTA, which keeps one cedge per connected cluster pair
+    size_t _num_edges = 0; // number of edges between the two clusters
+    size_t _satellite = 0; // index in Graph::_cedges
+
+};
+
+/*
+ * compressed-sparse-row (CSR) snapshot of a graph for read-only passes.
+ * nodes are indexed by their id (Node::_id), free ids are holes
+ * with nodes[id] == nullptr and no fanins/fanouts, so scratch arrays of
+ * size num_ids() can be indexed by id directly; ids lists the live nodes.
+ * the fanins of node i are fanins[fanin_offsets[i]] ... fanins[fanin_offsets[i+1]-1],
+ * and the fanouts of node i are fanouts[fanout_offsets[i]] ... fanouts[fanout_offsets[i+1]-1].
+ * the order of fanins/fanouts is the same as the order in Node::_fanins/_fanouts.
+ */
+struct FrozenGraph {
+
+  std::vector<uint32_t> ids; // ids of live nodes, in the order of Graph::_nodes
+  std::vector<Node*> nodes; // id -> node
+  std::vector<size_t> fanin_offsets;
+  std::vector<size_t> fanout_offsets;
+  std::vector<uint32_t> fanins;
+  std::vector<uint32_t> fanouts;
+
+  inline size_t num_nodes() const {
+    return ids.size();
+  }
+
+  inline size_t num_ids() const {
+    return nodes.size();
+  }
+
+  inline size_t num_fanins(uint32_t v) const {
+    return fanin_offsets[v+1] - fanin_offsets[v];
+  }
+
+  inline size_t num_fanouts(uint32_t v) const {
+    return fanout_offsets[v+1] - fanout_offsets[v];
+  }
+};
+
+/*
+ * a graph with its linear chains collapsed into supernodes (see Graph::compress_chains).
+ * an edge u -> v is inside a chain if it is the only fanout of u and the only fanin of v,
+ * a maximal run of such edges becomes one supernode, cut into segments where its cost
+ * would exceed the cap. graph is a FrozenGraph over supernode ids 0 ... num_nodes()-1
+ * without holes, graph.nodes[s] is the first member of supernode s; the members of s
+ * are members[member_offsets[s]] ... members[member_offsets[s+1]-1] in chain order,
+ * and super_of maps a node id of the original snapshot to its supernode.
+ */
+struct ChainCompression {
+
+  FrozenGraph graph;
+  std::vector<size_t> member_offsets;
+  std::vector<uint32_t> members;
+  std::vector<uint32_t> super_of; // node id -> supernode, UINT32_MAX at free ids
+  std::vector<uint32_t> cost;     // total cost of the members (saturated)
+
+  inline size_t num_nodes() const {
+    return graph.num_nodes();
+  }
+
+  inline size_t num_members(uint32_t s) const {
+    return member_offsets[s+1] - member_offsets[s];
+  }
+};
+
+/*
+ * a batch of graph edits applied at once by Graph::apply.
+ * nodes created by the batch do not have a NodeId yet, so edges refer to their
+ * endpoints through a NodeRef, either an existing node or the index returned by add_node.
+ */
+struct GraphDelta {
+
+  struct NodeRef {
+    NodeId id; // existing node
+    size_t pending = std::numeric_limits<size_t>::max(); // index in insert_nodes for a new node
+
+    NodeRef(NodeId id) : id {id} {}
+    NodeRef(size_t pending) : pending {pending} {}
+
+    inline bool is_new() const {
+      return pending != std::numeric_limits<size_t>::max();
+    }
+  };
+
+  std::vector<EdgeId> remove_edges;
+  std::vector<NodeId> remove_nodes;
+  std::vector<std::string> insert_nodes; // names of the new nodes
+  std::vector<std::pair<NodeRef, NodeRef>> insert_edges;
+
+  inline NodeRef add_node(std::string name = "") {
+    insert_nodes.push_back(std::move(name));
+    return NodeRef(insert_nodes.size() - 1);
+  }
+  inline void add_edge(NodeRef from, NodeRef to) {
+    insert_edges.emplace_back(from, to);
+  }
+  inline void remove_node(NodeId id) {
+    remove_nodes.push_back(id);
+  }
+  inline void remove_edge(EdgeId id) {
+    remove_edges.push_back(id);
+  }
+
+  inline bool empty() const {
+    return remove_edges.empty() && remove_nodes.empty() && insert_nodes.empty() && insert_edges.empty();
+  }
+  inline void clear() {
+    remove_edges.clear();
+    remove_nodes.clear();
+    insert_nodes.clear();
+    insert_edges.clear();
+  }
+};
+
+/*
+ * one batch of a changelog: graph edits that refer to nodes by name.
+ * Graph::replay turns it into a GraphDelta, so the edits take effect in the same
+ * order: edge removals, node removals, node insertions, then edge insertions.
+ * names are views, batches returned by ChangelogReader point into its file.
+ */
+struct ChangeBatch {
+
+  std::vector<std::pair<std::string_view, std::string_view>> remove_edges;
+  std::vector<std::string_view> remove_nodes;
+  std::vector<std::string_view> insert_nodes;
+  std::vector<std::pair<std::string_view, std::string_view>> insert_edges;
+
+  inline bool empty() const {
+    return remove_edges.empty() && remove_nodes.empty() && insert_nodes.empty() && insert_edges.empty();
+  }
+  inline void clear() {
+    remove_edges.clear();
+    remove_nodes.clear();
+    insert_nodes.clear();
+    insert_edges.clear();
+  }
+};
+
+/*
+ * sequential reader of a changelog file, one batch at a time.
+ * the file is mapped rather than read, so only the pages of the current batch
+ * need to be resident. both formats are recognized:
+ *
+ *   text:                        binary (written by ChangelogWriter):
+ *   batch;                       "PASTACL\0", uint32 version, uint32 flags
+ *   - "A" -> "B";  remove edge   per batch: varint number of records, then per record
+ *   - "C";         remove node   one op byte (0 remove edge, 1 remove node,
+ *   + "D";         insert node   2 insert node, 3 insert edge) followed by
+ *   + "D" -> "B";  insert edge   one or two names (varint length, characters)
+ *   batch;
+ *   ...
+ *
+ * errors throw std::runtime_error.
+ */
+class ChangelogReader {
+
+  public:
+
+    explicit ChangelogReader(const std::string& path);
+
+    // read the next batch into batch; return false at the end of the file
+    bool next(ChangeBatch& batch);
+
+    // number of batches read so far
+    inline size_t num_batches() const {
+      return _num_batches;
+    }
+
+  private:
+
+    MappedFile _file;
+    const char* _cur = nullptr;
+    const char* _end = nullptr;
+    bool _binary = false;
+    size_t _num_batches = 0;
+
+    bool _next_text(ChangeBatch& batch);
+    bool _next_binary(ChangeBatch& batch);
+};
+
+/*
+ * writes a changelog batch by batch, in the text or the binary format
+ * (see ChangelogReader). throws std::runtime_error if the file cannot be written,
+ * or if a name holds a quote or a line break, which only the binary format can store.
+ * a batch that throws is not written at all.
+ */
+class ChangelogWriter {
+
+  public:
+
+    ChangelogWriter(const std::string& path, bool binary = false);
+
+    void write(const ChangeBatch& batch);
+
+  private:
+
+    std::ofstream _out;
+    bool _binary;
+    std::string _path;
+    std::vector<char> _buf;
 };
 
 class Graph {
 
   public:
     // constructors
+    // the file is either the benchmark text format or a file written by save_binary
     Graph() {};
     Graph(const std::string& filename);
 
+    // cone-restricted loading: materialize only the roots and the nodes on the given side
+    // of them, with the edges among those nodes, in file order.
+    // adjacency, node costs and a name table come from the cone index index_file (see
+    // build_cone_index). the graph file is hashed once to check that the index is still
+    // its own, and otherwise only read for the names the lookup and the cone need.
+    // an empty index_file means filename + ".cone".
+    // the index has to be built beforehand, since building it reads the whole design;
+    // like the file constructor, errors (including a missing or stale index and
+    // unknown roots) are fatal
+    Graph(const std::string& filename, const std::vector<std::string>& roots,
+          ConeDirection direction = ConeDirection::Fanin, const std::string& index_file = "");
+
+    // write the cone index of a text or binary graph file: name locations, a name table,
+    // node costs, the fanin/fanout CSR by node position and a hash of the file bytes;
+    // throws std::runtime_error on failure
+    static void build_cone_index(const std::string& filename, const std::string& index_file);
+
+    // versioned binary format: a header, the node names and varint-encoded CSR fanouts
+    // load_binary requires an empty graph; both throw std::runtime_error on failure
+    void save_binary(const std::string& path) const;
+    void load_binary(const std::string& path);
+
      // basic ops
-    Node* insert_node(const std::string& name = "", RunMode mode = RunMode::None, size_t matrix_size = 8);
-    Edge* insert_edge(Node* from, Node* to, RunMode mode = RunMode::None);
-    void remove_node(Node* node, RunMode mode = RunMode::None);
-    void remove_edge(Edge* edge, RunMode mode = RunMode::None);
+     // operations on a stale handle (removed node/edge) throw std::runtime_error
+    NodeId insert_node(const std::string& name = "", RunMode mode = RunMode::None, size_t matrix_size = 8);
+    EdgeId insert_edge(NodeId from, NodeId to, RunMode mode = RunMode::None);
+    void remove_node(NodeId node, RunMode mode = RunMode::None);
+    void remove_edge(EdgeId edge, RunMode mode = RunMode::None);
+
+    // handle lookup
+    bool contains(NodeId id) const;
+    bool contains(EdgeId id) const;
+
+    // node attributes
+    // throw std::runtime_error if the handle is stale
+    // the returned view is invalidated by the next insert_node/remove_node
+    std::string_view name(NodeId id) const;
+    size_t num_fanins(NodeId id) const;
+    size_t num_fanouts(NodeId id) const;
+
+    // cost (work) of a node in arbitrary units, 1 unless set here or in the input file;
+    // C-PASTA fills a cluster up to a total cost of partition_size, and the
+    // run_graph_* functions repeat the work of a node cost times.
+    // set_cost also throws std::runtime_error on a zero cost
+    void set_cost(NodeId id, uint32_t cost);
+    uint32_t cost(NodeId id) const;
+
+    // C-PASTA cluster of a node, -1 if it has not been partitioned yet
+    int cluster_of(NodeId id) const;
+
+    // edge index
+    // when enabled, (from, to) pairs are hashed so find_edge is O(1),
+    // and insert_edge rejects parallel edges by returning the handle of the existing edge
+    // disabled by default, find_edge then scans the fanouts of from
+    void enable_edge_index(bool enable = true);
+    inline bool has_edge_index() const {
+      return _edge_index_enabled;
+    }
+
+    // return the handle of an edge from -> to, or EdgeId{} if there is none
+    EdgeId find_edge(NodeId from, NodeId to) const;
+
+    // return the handle of a node with the given name, or NodeId{} if there is none
+    // unnamed nodes are not indexed; with duplicate names any one of them is returned
+    NodeId find_node(std::string_view name) const;
+
+    // apply a batch of edits: edge removals, node removals, node insertions, then edge insertions
+    // the whole batch is validated first (stale handles, edges to removed nodes, cycles)
+    // and std::runtime_error is thrown with the graph left untouched if it is invalid;
+    // taskflow tasks are patched once for the whole batch
+    // return the handles of the new nodes in the order of delta.insert_nodes
+    std::vector<NodeId> apply(const GraphDelta& delta, RunMode mode = RunMode::None, size_t matrix_size = 8);
+
+    // stream a changelog (see ChangelogReader) into the graph, one apply() per batch;
+    // names are resolved against the graph as it is before each batch, and a batch may
+    // connect the nodes it inserts. on_batch, if given, runs after every batch with
+    // its index, e.g. to repartition and rerun the graph.
+    // return the number of batches applied; a malformed file or an invalid batch throws
+    // std::runtime_error, the batches before it stay applied
+    size_t replay(const std::string& changelog, RunMode mode = RunMode::None, size_t matrix_size = 8,
+                  const std::function<void(size_t)>& on_batch = {});
 
     // remove N nodes randomly
     void remove_random_nodes(size_t N, std::mt19937& gen, RunMode mode = RunMode::None);
@@ -149,9 +573,9 @@ class Graph {
     size_t add_random_edges(size_t N, std::mt19937& gen, size_t max_tries_multiplier = 20, RunMode mode = RunMode::None); 
 
     // add N nodes randomly
-    std::vector<Node*> add_random_nodes(size_t N, std::mt19937& gen, 
-                                        const std::string& name_prefix = "new", 
-                                        RunMode mode = RunMode::None, size_t matrix_size = 8);
+    std::vector<NodeId> add_random_nodes(size_t N, std::mt19937& gen, 
+                                         const std::string& name_prefix = "new", 
+                                         RunMode mode = RunMode::None, size_t matrix_size = 8);
 
     // helper
     inline size_t num_nodes() const {
@@ -160,6 +584,7 @@ class Graph {
     inline size_t num_edges() const {
       return _edges.size();
     }
+    // the cost budget of a cluster, which is its number of nodes if no costs are set
     inline void set_partition_size(const size_t partition_size) {
       _partition_size = partition_size;
     }
@@ -181,6 +606,39 @@ class Graph {
     }
     void test_func();
 
+    // build the CSR snapshot of the current graph
+    // the snapshot is cached and only rebuilt after the graph is mutated
+    // if enough nodes were inserted/removed since the last compaction, compact() runs first
+    const FrozenGraph& freeze();
+
+    // renumber node ids in topological (level-by-level) order and rebuild
+    // the per-node arrays, adjacency lists and _nodes/_edges in that order,
+    // so traversals walk memory mostly forward after long runs of edits
+    // NodeId/EdgeId handles stay valid
+    void compact();
+
+    // collapse the linear chains of the current graph into supernodes (see ChainCompression),
+    // cutting a chain wherever its cost would exceed max_cost (0 = never); a single node
+    // may exceed it. the result is cached like the snapshot and rebuilt after the graph or
+    // a cost changes, or for a different max_cost.
+    // throws std::runtime_error if the graph has a cycle
+    const ChainCompression& compress_chains(size_t max_cost = 0);
+
+    // when enabled, partition_c_pasta clusters the supernodes of compress_chains(partition
+    // size) instead of the nodes, the cudaflow partitions order whole chains into one
+    // stream, and run_graph_before_partition runs one task per chain. all of them cap the
+    // chains at the partition size, so they share one cached compression.
+    // disabled by default
+    inline void set_chain_compression(bool enable) {
+      _compress_chains = enable;
+    }
+
+    // compact automatically once the number of node insertions/removals since the
+    // last compaction exceeds threshold * num_nodes(); 0 disables it
+    inline void set_compact_threshold(double threshold) {
+      _compact_threshold = threshold;
+    }
+
     // check cycle
     bool has_cycle_before_partition();
     bool has_cycle_after_partition();
@@ -188,6 +646,74 @@ class Graph {
     // C-PASTA
     void partition_c_pasta();
 
+    // paths are measured by node costs, or by node count if cost_weighted is false.
+    // a node is critical if the longest path through it is at most critical_slack
+    // (a fraction) shorter than the critical path of the graph, and its critical path
+    // continues through its fanout with the longest path to a sink.
+    // the incremental and warm-start repairs place nodes greedily under either strategy
+    inline void set_c_pasta_strategy(CPastaStrategy strategy, double critical_slack = 0.1,
+                                     bool cost_weighted = true) {
+      _cpasta_strategy = strategy;
+      _cpasta_critical_slack = critical_slack;
+      _cpasta_cost_weighted = cost_weighted;
+    }
+
+    // deterministic C-PASTA assigns nodes level by level in a fixed order, so the same
+    // graph (the same sequence of edits) gives the same clusters for any number of threads.
+    // it is off by default: the clusters are the same in spirit but not identical to those
+    // of the work-stealing traversal, and every level is a synchronization point
+    inline void set_c_pasta_deterministic(bool deterministic) {
+      _cpasta_deterministic = deterministic;
+    }
+
+    // number of workers of the work-stealing traversal; 0 (the default) picks one per
+    // 512 nodes, up to the number of executor workers. more workers than the executor
+    // has are fine, the ones it does not start in time are dropped
+    inline void set_c_pasta_num_threads(size_t num_threads) {
+      _cpasta_num_threads = num_threads;
+    }
+
+    // multilevel partition: coarsen the graph by heavy-edge matching that keeps it acyclic,
+    // cluster the coarsest level by C-PASTA (with its strategy and determinism settings),
+    // then project the clusters back level by level, moving boundary nodes between
+    // neighbouring clusters to cut fewer edges and even out their cost.
+    // clusters keep the partition size and the cluster graph stays acyclic.
+    // slower than partition_c_pasta, but the partition has fewer cedges
+    void partition_multilevel();
+
+    // incremental C-PASTA
+    // repartition after the edits made since the last call: inserted nodes are placed,
+    // an inserted edge against the order of the clusters reorders them, and only if the
+    // clusters would form a cycle are its head and the nodes downstream of it moved.
+    // _cnodes/_cedges are patched in place, with one cedge per connected cluster pair.
+    // the first call, and the first after partition_c_pasta, load_partition or a change
+    // of the partition size, runs a full partition_c_pasta and starts tracking edits.
+    // clusters are then ordered by a rank instead of by id, so cluster ids are no
+    // longer nondecreasing along edges (save_partition renumbers them)
+    void partition_c_pasta_incremental();
+
+    // check that every node is in a cluster within the partition size (by cost, a single
+    // node may exceed it) and that there is exactly one cedge for every pair of clusters
+    // that edges connect
+    bool is_c_pasta_partition_consistent();
+
+    // partition persistence
+    // content_hash depends only on the node names, their costs and the edges between them,
+    // not on insertion order, ids or memory layout
+    uint64_t content_hash() const;
+
+    // save the current C-PASTA and cudaflow partitions, keyed by content_hash()
+    // and the parameters they were computed with (partition size, number of streams);
+    // throws std::runtime_error if the file cannot be written
+    void save_partition(const std::string& path) const;
+
+    // warm start: restore a partition written by save_partition, nodes are matched by name
+    // if the graph changed since saving, the C-PASTA clusters are repaired around the
+    // edited nodes (the rest keep their cluster) and the cudaflow partition is recomputed
+    // return false and leave the partitions untouched if the file does not exist or
+    // the partition size differs; throws std::runtime_error if the file is corrupt
+    bool load_partition(const std::string& path);
+
     // CUDAFlow partition
     // reconstruct graph based on cudaflow
     void partition_cudaflow(size_t num_streams = 4);
@@ -215,15 +741,82 @@ class Graph {
   private:
 
     size_t _partition_size = 0;
+    CPastaStrategy _cpasta_strategy = CPastaStrategy::Greedy;
+    double _cpasta_critical_slack = 0.1;
+    bool _cpasta_cost_weighted = true;
+    bool _cpasta_deterministic = false;
+    size_t _cpasta_num_threads = 0;
     int _max_cluster_id = -1; // record the largest cluster id
+    size_t _num_streams = 0; // streams of the cudaflow partition, 0 if there is none or the graph changed since
+    bool _incremental_streams = false; // whether it came from partition_cudaflow_incremental
+
+    /*
+     * nodes, edges, cnodes and cedges live in typed slabs and are recycled 
+     * through free lists, per-node attributes live in _store.
+     * _nodes/_edges/_cnodes/_cedges hold the live objects in a dense vector,
+     * removal swaps the last element into the hole (see _node_satellite/_satellite).
+     */
+    NodeStore _store;
+    ObjectPool<Node> _node_pool;
+    ObjectPool<Edge> _edge_pool;
+    ObjectPool<CNode> _cnode_pool;
+    ObjectPool<CEdge> _cedge_pool;
+
+    std::vector<Node*> _nodes;
+    std::vector<Edge*> _edges;
+    std::vector<CNode*> _cnodes;
+    std::vector<CEdge*> _cedges;
+
+    // CSR snapshot used by all read-only passes
+    // invalidated by insert_node/insert_edge/remove_node/remove_edge
+    FrozenGraph _frozen;
+    bool _frozen_valid = false;
+
+    // chain compression of the snapshot, invalidated along with it and by set_cost
+    ChainCompression _chains;
+    bool _chains_valid = false;
+    size_t _chains_max_cost = 0;
+    bool _compress_chains = false;
+
+    // node insertions/removals since the last compact()
+    size_t _num_node_edits = 0;
+    double _compact_threshold = 1.0;
+
+    // (from id, to id) -> edge, maintained by _insert_edge/_remove_edge when enabled
+    EdgeIndex<Edge*> _edge_index;
+    bool _edge_index_enabled = false;
+
+    // parsers behind the file constructor
+    void _load_text(std::string_view text);
+    void _load_binary(std::string_view data);
+    void _load_cone(std::string_view data, std::string_view index, const std::vector<std::string>& roots,
+                    ConeDirection direction);
+
+    // pointer-based basic ops behind the handle API
+    Node* _insert_node(std::string_view name, RunMode mode, size_t matrix_size);
+    Edge* _insert_edge(Node* from, Node* to, RunMode mode);
+    void _remove_node(Node* node, RunMode mode);
+    void _remove_edge(Edge* edge, RunMode mode);
+
+    inline NodeId _handle(const Node* node) const {
+      return {ObjectPool<Node>::index_of(node), ObjectPool<Node>::generation_of(node)};
+    }
+    inline EdgeId _handle(const Edge* edge) const {
+      return {ObjectPool<Edge>::index_of(edge), ObjectPool<Edge>::generation_of(edge)};
+    }
+    Node* _node(NodeId id) const;
+    Node* _find_node(std::string_view name) const;
 
-    std::list<Node> _nodes;
-    std::list<Edge> _edges;
-    std::list<CNode> _cnodes;
-    std::list<CEdge> _cedges;
+    std::vector<NodeId> _apply(const GraphDelta& delta, RunMode mode, size_t matrix_size, bool check_cycle);
+    bool _has_cycle_after_edit(const std::vector<Node*>& removed_nodes, const std::vector<Edge*>& removed_edges,
+                               size_t num_new_nodes, const std::vector<std::pair<uint32_t, uint32_t>>& new_edges);
+    void _emplace_task(Node* node, RunMode mode, size_t matrix_size);
+    Edge* _find_edge(Node* from, Node* to) const;
 
     // get level list of current graph 
+    // (with chain compression, see _get_chain_level_list)
     std::vector<std::vector<Node*>> _get_level_list();
+    std::vector<std::vector<Node*>> _get_chain_level_list();
 
     // get topological order of current graph using BFS
     std::vector<Node*> _get_topo_order_bfs();
@@ -234,10 +827,43 @@ class Graph {
     template <typename T>
     void _topo_dfs(std::vector<T*>& topo_order, T* node);
 
-    void _assign_cluster_id(Node* node_ptr, std::vector<std::atomic<size_t>>& cluster_cnt, std::atomic<int>& max_cluster_id);
+    // C-PASTA on g with node costs cost (indexed by the ids of g), where g is the snapshot
+    // or a chain compression of it; size, if given, is the number of nodes behind every
+    // node of g. writes cluster_ids (sized g.num_ids()) and returns the largest cluster id
+    int _cluster_c_pasta(const FrozenGraph& g, const std::vector<uint32_t>& cost,
+                         const std::vector<uint32_t>* size, std::vector<int>& cluster_ids);
+
+    void _assign_cluster_id(const FrozenGraph& g, const std::vector<uint32_t>& cost, uint32_t v,
+                            std::vector<int>& cluster_ids, std::vector<std::atomic<size_t>>& cluster_cnt,
+                            std::atomic<int>& max_cluster_id);
+
+    // whether the strategy lets node v (not a source) join its desired cluster
+    bool _may_join(const FrozenGraph& g, uint32_t v, int desired_cluster_id,
+                   const std::vector<int>& cluster_ids) const;
+
+    // deterministic C-PASTA (see set_c_pasta_deterministic), returns the largest cluster id
+    int _assign_cluster_ids_by_level(const FrozenGraph& g, const std::vector<uint32_t>& cost,
+                                     std::vector<int>& cluster_ids);
+
+    // CPastaStrategy::CriticalPath: the critical successor of every critical node
+    // into _cpasta_critical
+    void _find_critical_paths(const FrozenGraph& g, const std::vector<uint32_t>& cost,
+                              const std::vector<uint32_t>* size);
 
     void _build_partitioned_graph();
 
+    // make the cluster ids of a warm-started C-PASTA partition valid for the current graph
+    void _repair_cluster_ids(std::vector<int>& cluster_ids);
+
+    // incremental C-PASTA, see partition_c_pasta_incremental
+    void _track_partitioned_graph();
+    void _count_cedge(int from, int to, bool insert);
+    void _move_to_cluster(Node* node, int cluster_id);
+    bool _reorder_clusters(int from, int to);
+    int _open_cluster(int after);
+    void _close_cluster(int cluster_id);
+    void _relabel_clusters();
+
     // incremental update with semaphore runtime
     size_t _incre_runtime_with_semaphore = 0;
     size_t _incre_runtime_with_semaphore_graph_construct = 0;
@@ -247,6 +873,32 @@ class Graph {
     size_t _incre_partition_runtime_with_cudaflow_partition = 0;
     size_t _incre_construct_runtime_with_cudaflow = 0;
 
+    // scratch state of partition_c_pasta, kept across calls
+    std::vector<WorkStealingQueue<uint32_t>> _cpasta_queues;
+    std::vector<std::atomic<size_t>> _cpasta_dep_cnt;
+    std::vector<std::atomic<size_t>> _cpasta_cluster_cnt;
+    std::vector<uint32_t> _cpasta_critical; // fanout on the critical path (the node itself at a sink)
+    std::vector<char> _cpasta_critical_cluster; // whether a cluster was opened by a critical node
+
+    /*
+     * state of incremental C-PASTA, valid while _cpasta_tracking is set.
+     * the non-empty clusters are kept in a topological order of the cluster graph
+     * by gapped ranks, rank(cluster(u)) <= rank(cluster(v)) for every edge u -> v
+     * (while _cpasta_ordered). an inserted edge against that order only reorders the
+     * clusters between its ends, nodes move only if the clusters would form a cycle.
+     * clusters emptied by edits are recycled through _free_clusters.
+     * _cedge_index maps (from cluster, to cluster) to its cedge.
+     */
+    bool _cpasta_tracking = false;
+    bool _cpasta_ordered = false; // no edge goes against the cluster ranks
+    size_t _cpasta_tracked_size = 0; // partition size of the tracked partition
+    std::vector<NodeId> _cpasta_dirty; // inserted nodes and heads of edges against the ranks
+    std::vector<uint64_t> _cluster_rank;
+    std::vector<size_t> _cluster_cost; // total cost of the nodes in each cluster
+    std::map<uint64_t, int> _cluster_order; // rank -> cluster id of the non-empty clusters
+    std::vector<int> _free_clusters;
+    EdgeIndex<CEdge*> _cedge_index;
+
     tf::Taskflow _taskflow;
     tf::Executor _executor{std::thread::hardware_concurrency()};
     tf::Semaphore _semaphore{std::thread::hardware_concurrency()};  
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+/**
+@class: ObjectPool
+
+@tparam T object type
+@tparam S number of objects per slab
+
+@brief Typed slab allocator with a free list.
+
+Objects are constructed in place inside fixed-size slabs.
+Slabs are never moved or released before the pool is destroyed,
+so pointers to live objects stay valid for their whole lifetime.
+Deallocated slots are pushed onto a free list and reused by the next allocation,
+so a steady stream of insertions and removals does not touch the system allocator.
+
+Every slot has a stable index (slab * S + offset) and a generation that is
+bumped whenever the object in the slot is destroyed. Because freed slots are
+recycled, indices never exceed the peak number of live objects (rounded up to S),
+which lets callers use them as dense ids into flat side arrays.
+
+This class is not thread-safe.
+*/
+template <typename T, size_t S = 1024>
+class ObjectPool {
+
+  struct Slot {
+    // storage must be the first member so a T* can be cast back to its Slot*
+    alignas(T) unsigned char storage[sizeof(T)];
+    Slot* next {nullptr};
+    uint32_t index {0};
+    uint32_t generation {0};
+    bool live {false};
+  };
+
+  std::vector<std::unique_ptr<Slot[]>> _slabs;
+  Slot* _free {nullptr};
+  size_t _size {0};
+
+  void _grow() {
+    size_t base = _slabs.size() * S;
+    Slot* slab = _slabs.emplace_back(new Slot[S]).get();
+    // link the slots in reverse so the new slab is handed out in address order
+    for(size_t i=S; i-- > 0;) {
+      slab[i].index = static_cast<uint32_t>(base + i);
+      slab[i].next = _free;
+      _free = &slab[i];
+    }
+  }
+
+  public:
+
+    ObjectPool() = default;
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator = (const ObjectPool&) = delete;
+
+    /**
+    @brief destructs the pool and all objects that are still alive
+    */
+    ~ObjectPool() {
+      clear();
+    }
+
+    /**
+    @brief constructs an object in a free slot
+    */
+    template <typename... ArgsT>
+    T* allocate(ArgsT&&... args) {
+      if(_free == nullptr) {
+        _grow();
+      }
+      Slot* slot = _free;
+      T* obj = ::new (static_cast<void*>(slot->storage)) T(std::forward<ArgsT>(args)...);
+      _free = slot->next;
+      slot->live = true;
+      ++_size;
+      return obj;
+    }
+
+    /**
+    @brief destroys an object and returns its slot to the free list
+    */
+    void deallocate(T* obj) {
+      Slot* slot = reinterpret_cast<Slot*>(obj);
+      obj->~T();
+      slot->live = false;
+      ++slot->generation;
+      slot->next = _free;
+      _free = slot;
+      --_size;
+    }
+
+    /**
+    @brief destroys all live objects but keeps the slabs for reuse
+    */
+    void clear() {
+      _free = nullptr;
+      for(size_t s=_slabs.size(); s-- > 0;) {
+        Slot* slab = _slabs[s].get();
+        for(size_t i=S; i-- > 0;) {
+          if(slab[i].live) {
+            reinterpret_cast<T*>(slab[i].storage)->~T();
+            slab[i].live = false;
+            ++slab[i].generation;
+          }
+          slab[i].next = _free;
+          _free = &slab[i];
+        }
+      }
+      _size = 0;
+    }
+
+    /**
+    @brief returns the stable slot index of a live object
+    */
+    static uint32_t index_of(const T* obj) noexcept {
+      return reinterpret_cast<const Slot*>(obj)->index;
+    }
+
+    /**
+    @brief returns the generation of the slot that holds a live object
+    */
+    static uint32_t generation_of(const T* obj) noexcept {
+      return reinterpret_cast<const Slot*>(obj)->generation;
+    }
+
+    /**
+    @brief returns the live object at the given slot index and generation,
+           or nullptr if the slot is free or has been reused since
+    */
+    T* at(size_t index, uint32_t generation) const noexcept {
+      if(index >= capacity()) {
+        return nullptr;
+      }
+      Slot& slot = _slabs[index / S][index % S];
+      if(!slot.live || slot.generation != generation) {
+        return nullptr;
+      }
+      return reinterpret_cast<T*>(slot.storage);
+    }
+
+    /**
+    @brief returns the number of live objects
+    */
+    size_t size() const noexcept {
+      return _size;
+    }
+
+    /**
+    @brief returns the number of slots allocated so far
+    */
+    size_t capacity() const noexcept {
+      return _slabs.size() * S;
+    }
+};
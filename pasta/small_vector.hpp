@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+@class: SmallVector
+
+@tparam T data type (must be trivially copyable)
+@tparam N number of elements stored inline
+
+@brief Vector with inline storage for the first N elements.
+
+Elements live inside the object until the size exceeds N,
+then they move to a heap buffer that grows geometrically.
+clear() keeps the current buffer, so a recycled vector does not reallocate.
+Since T is trivially copyable, elements are moved with memcpy
+and never constructed or destroyed individually.
+*/
+template <typename T, size_t N>
+class SmallVector {
+
+  static_assert(std::is_trivially_copyable_v<T>, "SmallVector only holds trivially copyable types");
+  static_assert(N > 0, "SmallVector needs at least one inline element");
+
+  T* _data {_inline};
+  uint32_t _size {0};
+  uint32_t _capacity {N};
+  T _inline[N];
+
+  bool _is_inline() const noexcept {
+    return _data == _inline;
+  }
+
+  void _grow(size_t capacity) {
+    T* data = static_cast<T*>(::operator new(capacity * sizeof(T)));
+    std::memcpy(data, _data, _size * sizeof(T));
+    if(!_is_inline()) {
+      ::operator delete(_data);
+    }
+    _data = data;
+    _capacity = static_cast<uint32_t>(capacity);
+  }
+
+  void _steal(SmallVector& rhs) noexcept {
+    if(rhs._is_inline()) {
+      _data = _inline;
+      _capacity = N;
+      std::memcpy(_inline, rhs._inline, rhs._size * sizeof(T));
+    }
+    else {
+      _data = rhs._data;
+      _capacity = rhs._capacity;
+      rhs._data = rhs._inline;
+      rhs._capacity = N;
+    }
+    _size = rhs._size;
+    rhs._size = 0;
+  }
+
+  public:
+
+    using value_type = T;
+    using iterator = T*;
+    using const_iterator = const T*;
+
+    SmallVector() = default;
+
+    SmallVector(const SmallVector& rhs) {
+      *this = rhs;
+    }
+
+    SmallVector(SmallVector&& rhs) noexcept {
+      _steal(rhs);
+    }
+
+    ~SmallVector() {
+      if(!_is_inline()) {
+        ::operator delete(_data);
+      }
+    }
+
+    SmallVector& operator = (const SmallVector& rhs) {
+      if(this != &rhs) {
+        _size = 0;
+        reserve(rhs._size);
+        std::memcpy(_data, rhs._data, rhs._size * sizeof(T));
+        _size = rhs._size;
+      }
+      return *this;
+    }
+
+    SmallVector& operator = (SmallVector&& rhs) noexcept {
+      if(this != &rhs) {
+        if(!_is_inline()) {
+          ::operator delete(_data);
+        }
+        _steal(rhs);
+      }
+      return *this;
+    }
+
+    size_t size() const noexcept { return _size; }
+    size_t capacity() const noexcept { return _capacity; }
+    bool empty() const noexcept { return _size == 0; }
+
+    T* data() noexcept { return _data; }
+    const T* data() const noexcept { return _data; }
+
+    iterator begin() noexcept { return _data; }
+    iterator end() noexcept { return _data + _size; }
+    const_iterator begin() const noexcept { return _data; }
+    const_iterator end() const noexcept { return _data + _size; }
+
+    T& operator [] (size_t i) noexcept { return _data[i]; }
+    const T& operator [] (size_t i) const noexcept { return _data[i]; }
+
+    T& front() noexcept { return _data[0]; }
+    const T& front() const noexcept { return _data[0]; }
+    T& back() noexcept { return _data[_size-1]; }
+    const T& back() const noexcept { return _data[_size-1]; }
+
+    void reserve(size_t capacity) {
+      if(capacity > _capacity) {
+        _grow(capacity);
+      }
+    }
+
+    void push_back(const T& value) {
+      if(_size == _capacity) {
+        // value may alias an element, so copy it before the buffer moves
+        T copy = value;
+        _grow(2 * static_cast<size_t>(_capacity));
+        _data[_size++] = copy;
+        return;
+      }
+      _data[_size++] = value;
+    }
+
+    void pop_back() noexcept {
+      --_size;
+    }
+
+    void clear() noexcept {
+      _size = 0;
+    }
+};
@@ -0,0 +1,1189 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <doctest.h>
+#include <fstream>
+#include <map>
+#include <set>
+#include "pasta.hpp"
+#include "generator.hpp"
+
+// --------------------------------------------------------
+// Testcase: check basic graph operations through handles 
+// --------------------------------------------------------
+
+TEST_CASE("node and edge handles.") {
+
+  pasta::Graph graph;
+
+  pasta::NodeId a = graph.insert_node("a");
+  pasta::NodeId b = graph.insert_node("b");
+  pasta::NodeId c = graph.insert_node("c");
+  pasta::EdgeId ab = graph.insert_edge(a, b);
+  pasta::EdgeId bc = graph.insert_edge(b, c);
+
+  REQUIRE(graph.num_nodes() == 3);
+  REQUIRE(graph.num_edges() == 2);
+  REQUIRE(graph.num_fanins(b) == 1);
+  REQUIRE(graph.num_fanouts(b) == 1);
+
+  // removing a node removes its incident edges and invalidates its handle
+  graph.remove_node(b);
+  REQUIRE(graph.num_nodes() == 2);
+  REQUIRE(graph.num_edges() == 0);
+  REQUIRE(graph.contains(b) == false);
+  REQUIRE(graph.contains(ab) == false);
+  REQUIRE(graph.contains(bc) == false);
+  REQUIRE_THROWS_AS(graph.remove_node(b), std::runtime_error);
+  REQUIRE_THROWS_AS(graph.insert_edge(a, b), std::runtime_error);
+
+  // the freed id is recycled, but the old handle stays stale
+  pasta::NodeId d = graph.insert_node("d");
+  REQUIRE(d.index == b.index);
+  REQUIRE(graph.contains(d) == true);
+  REQUIRE(graph.contains(b) == false);
+  REQUIRE(graph.num_fanins(d) == 0);
+  REQUIRE(graph.name(d) == "d");
+  REQUIRE_THROWS_AS(graph.name(b), std::runtime_error);
+
+  graph.insert_edge(a, d);
+  graph.insert_edge(d, c);
+  REQUIRE(graph.num_edges() == 2);
+  REQUIRE(graph.has_cycle_before_partition() == false);
+}
+
+TEST_CASE("random edits keep ids dense.") {
+
+  pasta::Graph graph("../../benchmarks/c432.txt");
+  std::mt19937 gen(42);
+
+  size_t peak = graph.num_nodes();
+  for(int i=0; i<100; i++) {
+    graph.remove_random_nodes(10, gen);
+    graph.remove_random_edges(10, gen);
+    graph.add_random_edges(10, gen);
+    graph.add_random_nodes(10, gen);
+    peak = std::max(peak, graph.num_nodes());
+    REQUIRE(graph.has_cycle_before_partition() == false);
+  }
+
+  // freed ids are recycled, so the id space is bounded by the peak number of nodes
+  const pasta::FrozenGraph& g = graph.freeze();
+  REQUIRE(g.num_nodes() == graph.num_nodes());
+  REQUIRE(g.num_ids() <= peak);
+  for(uint32_t v : g.ids) {
+    REQUIRE(v < g.num_ids());
+    REQUIRE(g.nodes[v] != nullptr);
+  }
+}
+
+TEST_CASE("high-degree adjacency.") {
+
+  pasta::Graph graph;
+
+  // a fanout list larger than the inline capacity spills to the heap
+  pasta::NodeId src = graph.insert_node("src");
+  std::vector<pasta::NodeId> sinks;
+  std::vector<pasta::EdgeId> edges;
+  for(int i=0; i<16; i++) {
+    sinks.push_back(graph.insert_node("sink" + std::to_string(i)));
+    edges.push_back(graph.insert_edge(src, sinks.back()));
+  }
+  REQUIRE(graph.num_fanouts(src) == 16);
+
+  // swap-remove from the middle keeps the remaining edges reachable
+  for(int i=0; i<16; i+=2) {
+    graph.remove_edge(edges[i]);
+  }
+  REQUIRE(graph.num_fanouts(src) == 8);
+  for(int i=1; i<16; i+=2) {
+    REQUIRE(graph.contains(edges[i]) == true);
+    graph.remove_edge(edges[i]);
+  }
+  REQUIRE(graph.num_fanouts(src) == 0);
+  REQUIRE(graph.num_edges() == 0);
+
+  for(auto& sink : sinks) {
+    graph.insert_edge(sink, src);
+  }
+  REQUIRE(graph.num_fanins(src) == 16);
+  graph.remove_node(src);
+  REQUIRE(graph.num_edges() == 0);
+  REQUIRE(graph.has_cycle_before_partition() == false);
+}
+
+TEST_CASE("csr snapshot.") {
+
+  // a fresh graph numbers its nodes in insertion order: a=0, b=1, c=2, d=3
+  pasta::Graph graph;
+  graph.set_compact_threshold(0);
+  pasta::NodeId a = graph.insert_node("a");
+  pasta::NodeId b = graph.insert_node("b");
+  pasta::NodeId c = graph.insert_node("c");
+  pasta::NodeId d = graph.insert_node("d");
+  pasta::EdgeId ab = graph.insert_edge(a, b);
+  graph.insert_edge(a, c);
+  graph.insert_edge(b, d);
+  graph.insert_edge(c, d);
+
+  auto fanouts_of = [](const pasta::FrozenGraph& g, uint32_t v) {
+    return std::vector<uint32_t>(g.fanouts.begin() + g.fanout_offsets[v], g.fanouts.begin() + g.fanout_offsets[v+1]);
+  };
+  auto fanins_of = [](const pasta::FrozenGraph& g, uint32_t v) {
+    return std::vector<uint32_t>(g.fanins.begin() + g.fanin_offsets[v], g.fanins.begin() + g.fanin_offsets[v+1]);
+  };
+
+  // the snapshot lists the adjacency in insertion order
+  const pasta::FrozenGraph& g = graph.freeze();
+  REQUIRE(g.ids == std::vector<uint32_t>{0, 1, 2, 3});
+  REQUIRE(g.fanout_offsets == std::vector<size_t>{0, 2, 3, 4, 4});
+  REQUIRE(g.fanin_offsets == std::vector<size_t>{0, 0, 1, 2, 4});
+  REQUIRE(fanouts_of(g, 0) == std::vector<uint32_t>{1, 2});
+  REQUIRE(fanins_of(g, 3) == std::vector<uint32_t>{1, 2});
+
+  // it is cached until the next edit
+  REQUIRE(&graph.freeze() == &g);
+  REQUIRE(g.fanouts.data() == graph.freeze().fanouts.data());
+
+  // a removed node leaves a hole, and the last node takes its place in ids
+  graph.remove_edge(ab);
+  graph.remove_node(b);
+  graph.freeze();
+  REQUIRE(g.num_nodes() == 3);
+  REQUIRE(g.num_ids() == 4);
+  REQUIRE(g.ids == std::vector<uint32_t>{0, 3, 2});
+  REQUIRE(g.nodes[1] == nullptr);
+  REQUIRE(g.num_fanins(1) == 0);
+  REQUIRE(g.num_fanouts(1) == 0);
+  REQUIRE(fanouts_of(g, 0) == std::vector<uint32_t>{2});
+  REQUIRE(fanins_of(g, 3) == std::vector<uint32_t>{2});
+  REQUIRE(g.num_fanouts(2) == graph.num_fanouts(c));
+  REQUIRE(g.num_fanins(3) == graph.num_fanins(d));
+
+  // the hole is filled by the next node
+  pasta::NodeId e = graph.insert_node("e");
+  graph.insert_edge(e, a);
+  graph.freeze();
+  REQUIRE(g.nodes[1] != nullptr);
+  REQUIRE(fanins_of(g, 0) == std::vector<uint32_t>{1});
+}
+
+TEST_CASE("edge removal back-references.") {
+
+  // hub has a fanin from and a fanout to every spoke
+  pasta::Graph graph;
+  pasta::NodeId hub = graph.insert_node("hub");
+  std::vector<pasta::NodeId> spokes;
+  std::vector<pasta::EdgeId> fanins, fanouts;
+  for(int i=0; i<64; i++) {
+    spokes.push_back(graph.insert_node("in" + std::to_string(i)));
+    fanins.push_back(graph.insert_edge(spokes.back(), hub));
+  }
+  for(int i=0; i<64; i++) {
+    spokes.push_back(graph.insert_node("out" + std::to_string(i)));
+    fanouts.push_back(graph.insert_edge(hub, spokes.back()));
+  }
+
+  // remove the edges in random order; every removal patches the position of the edge
+  // swapped into the hole, so exactly the remaining edges stay, on both of their ends
+  std::mt19937 gen(17);
+  std::vector<pasta::EdgeId> edges = fanins;
+  edges.insert(edges.end(), fanouts.begin(), fanouts.end());
+  std::shuffle(edges.begin(), edges.end(), gen);
+  std::set<uint32_t> expected_fanins, expected_fanouts;
+  for(uint32_t i=1; i<=64; i++) {
+    expected_fanins.insert(i);
+    expected_fanouts.insert(64 + i);
+  }
+  for(size_t k=0; k<edges.size(); k++) {
+    bool is_fanin = std::find(fanins.begin(), fanins.end(), edges[k]) != fanins.end();
+    uint32_t spoke = static_cast<uint32_t>(1 + (is_fanin ?
+      std::find(fanins.begin(), fanins.end(), edges[k]) - fanins.begin() :
+      64 + (std::find(fanouts.begin(), fanouts.end(), edges[k]) - fanouts.begin())));
+    graph.remove_edge(edges[k]);
+    (is_fanin ? expected_fanins : expected_fanouts).erase(spoke);
+
+    const pasta::FrozenGraph& g = graph.freeze();
+    REQUIRE(std::set<uint32_t>(g.fanins.begin() + g.fanin_offsets[0], g.fanins.begin() + g.fanin_offsets[1]) == expected_fanins);
+    REQUIRE(std::set<uint32_t>(g.fanouts.begin() + g.fanout_offsets[0], g.fanouts.begin() + g.fanout_offsets[1]) == expected_fanouts);
+    REQUIRE(g.num_fanins(0) == expected_fanins.size());
+    REQUIRE(g.num_fanouts(0) == expected_fanouts.size());
+    REQUIRE(graph.num_fanouts(spokes[spoke - 1]) + graph.num_fanins(spokes[spoke - 1]) == 0);
+    for(size_t j=k+1; j<edges.size(); j++) {
+      REQUIRE(graph.contains(edges[j]) == true);
+    }
+  }
+  REQUIRE(graph.num_edges() == 0);
+}
+
+TEST_CASE("edge index.") {
+
+  pasta::Graph graph;
+
+  pasta::NodeId a = graph.insert_node("a");
+  pasta::NodeId b = graph.insert_node("b");
+  pasta::NodeId c = graph.insert_node("c");
+  pasta::EdgeId ab = graph.insert_edge(a, b);
+
+  // without the index, find_edge scans fanouts and parallel edges are allowed
+  REQUIRE(graph.find_edge(a, b) == ab);
+  REQUIRE(graph.contains(graph.find_edge(b, a)) == false);
+  pasta::EdgeId ab2 = graph.insert_edge(a, b);
+  REQUIRE(graph.num_edges() == 2);
+
+  // the indexed parallel edge hands its entry over to the other one on removal
+  graph.enable_edge_index();
+  REQUIRE(graph.find_edge(a, b) == ab);
+  graph.remove_edge(ab);
+  REQUIRE(graph.find_edge(a, b) == ab2);
+  graph.remove_edge(ab2);
+  REQUIRE(graph.contains(graph.find_edge(a, b)) == false);
+
+  // duplicates are rejected on insert
+  pasta::EdgeId bc = graph.insert_edge(b, c);
+  REQUIRE(graph.insert_edge(b, c) == bc);
+  REQUIRE(graph.num_edges() == 1);
+
+  // the index follows node removal
+  graph.remove_node(b);
+  REQUIRE(graph.num_edges() == 0);
+  REQUIRE_THROWS_AS(graph.find_edge(b, c), std::runtime_error);
+  graph.insert_edge(a, c);
+  REQUIRE(graph.contains(graph.find_edge(a, c)) == true);
+  REQUIRE(graph.contains(graph.find_edge(c, a)) == false);
+}
+
+TEST_CASE("edge index under random edits.") {
+
+  pasta::Graph graph;
+  graph.enable_edge_index();
+
+  std::vector<pasta::NodeId> nodes;
+  for(int i=0; i<200; i++) {
+    nodes.push_back(graph.insert_node());
+  }
+
+  // reference edge set, edges always go from a lower to a higher position
+  std::map<std::pair<size_t, size_t>, pasta::EdgeId> ref;
+  std::mt19937 gen(7);
+  std::uniform_int_distribution<size_t> pick(0, nodes.size() - 1);
+  for(int i=0; i<20000; i++) {
+    size_t u = pick(gen), v = pick(gen);
+    if(u >= v) {
+      continue;
+    }
+    auto it = ref.find({u, v});
+    if(it == ref.end()) {
+      ref[{u, v}] = graph.insert_edge(nodes[u], nodes[v]);
+    }
+    else {
+      REQUIRE(graph.find_edge(nodes[u], nodes[v]) == it->second);
+      graph.remove_edge(it->second);
+      ref.erase(it);
+    }
+  }
+  REQUIRE(graph.num_edges() == ref.size());
+
+  for(size_t u=0; u<nodes.size(); u+=7) {
+    for(size_t v=u+1; v<nodes.size(); v+=3) {
+      auto it = ref.find({u, v});
+      pasta::EdgeId e = graph.find_edge(nodes[u], nodes[v]);
+      REQUIRE(graph.contains(e) == (it != ref.end()));
+    }
+  }
+}
+
+TEST_CASE("node lookup by name.") {
+
+  pasta::Graph graph("../../benchmarks/c432.txt");
+
+  // parsed nodes are reachable through their names
+  pasta::NodeId n17 = graph.find_node("17");
+  REQUIRE(graph.contains(n17) == true);
+  REQUIRE(graph.name(n17) == "17");
+
+  pasta::NodeId x = graph.insert_node("eco_x");
+  pasta::NodeId y = graph.insert_node("eco_y");
+  REQUIRE(graph.find_node("eco_x") == x);
+  REQUIRE(graph.find_node("eco_y") == y);
+  REQUIRE(graph.contains(graph.find_node("no_such_node")) == false);
+  REQUIRE(graph.contains(graph.find_node("")) == false);
+
+  graph.insert_edge(graph.find_node("eco_x"), graph.find_node("eco_y"));
+  REQUIRE(graph.num_fanouts(x) == 1);
+
+  // removed names disappear from the index, and the ids of recycled slots get the new name
+  graph.remove_node(x);
+  REQUIRE(graph.contains(graph.find_node("eco_x")) == false);
+  pasta::NodeId z = graph.insert_node("eco_z");
+  REQUIRE(z.index == x.index);
+  REQUIRE(graph.find_node("eco_z") == z);
+  REQUIRE(graph.name(z) == "eco_z");
+
+  // names survive the arena compaction triggered by heavy churn
+  for(int i=0; i<2000; i++) {
+    pasta::NodeId t = graph.insert_node("tmp_node_with_a_long_name_" + std::to_string(i));
+    graph.remove_node(t);
+  }
+  REQUIRE(graph.find_node("eco_y") == y);
+  REQUIRE(graph.name(z) == "eco_z");
+}
+
+TEST_CASE("batched edits.") {
+
+  pasta::Graph graph;
+
+  pasta::NodeId a = graph.insert_node("a");
+  pasta::NodeId b = graph.insert_node("b");
+  pasta::NodeId c = graph.insert_node("c");
+  pasta::EdgeId ab = graph.insert_edge(a, b);
+  graph.insert_edge(b, c);
+
+  // new nodes are referred to by the index returned from add_node
+  pasta::GraphDelta delta;
+  auto d = delta.add_node("d");
+  auto e = delta.add_node("e");
+  delta.add_edge(c, d);
+  delta.add_edge(d, e);
+  delta.add_edge(a, e);
+  delta.remove_edge(ab);
+  std::vector<pasta::NodeId> ids = graph.apply(delta);
+
+  REQUIRE(ids.size() == 2);
+  REQUIRE(graph.name(ids[0]) == "d");
+  REQUIRE(graph.find_node("e") == ids[1]);
+  REQUIRE(graph.num_nodes() == 5);
+  REQUIRE(graph.num_edges() == 4);
+  REQUIRE(graph.contains(ab) == false);
+  REQUIRE(graph.num_fanouts(a) == 1);
+  REQUIRE(graph.has_cycle_before_partition() == false);
+
+  // a batch that closes a cycle is rejected as a whole
+  delta.clear();
+  delta.remove_node(a);
+  delta.add_edge(ids[1], b);
+  REQUIRE_THROWS_AS(graph.apply(delta), std::runtime_error);
+  REQUIRE(graph.contains(a) == true);
+  REQUIRE(graph.num_nodes() == 5);
+  REQUIRE(graph.num_edges() == 4);
+
+  // so is an edge to a node removed in the same batch
+  delta.clear();
+  delta.remove_node(c);
+  delta.add_edge(a, c);
+  REQUIRE_THROWS_AS(graph.apply(delta), std::runtime_error);
+  REQUIRE(graph.contains(c) == true);
+
+  // duplicate removals are applied once
+  delta.clear();
+  delta.remove_node(b);
+  delta.remove_node(b);
+  graph.apply(delta);
+  REQUIRE(graph.num_nodes() == 4);
+  REQUIRE(graph.num_edges() == 3);
+  REQUIRE(graph.has_cycle_before_partition() == false);
+}
+
+TEST_CASE("compaction.") {
+
+  pasta::Graph graph("../../benchmarks/c6288.txt");
+  graph.set_compact_threshold(0);
+  graph.enable_edge_index();
+  std::mt19937 gen(3);
+
+  for(int i=0; i<50; i++) {
+    graph.remove_random_nodes(20, gen);
+    graph.remove_random_edges(20, gen);
+    graph.add_random_edges(20, gen);
+    graph.add_random_nodes(20, gen);
+  }
+  pasta::NodeId x = graph.insert_node("x");
+  pasta::NodeId y = graph.insert_node("y");
+  pasta::EdgeId xy = graph.insert_edge(x, y);
+  size_t num_nodes = graph.num_nodes();
+  size_t num_edges = graph.num_edges();
+
+  graph.compact();
+
+  // handles, names and the edge index survive the renumbering
+  REQUIRE(graph.num_nodes() == num_nodes);
+  REQUIRE(graph.num_edges() == num_edges);
+  REQUIRE(graph.contains(x) == true);
+  REQUIRE(graph.find_node("y") == y);
+  REQUIRE(graph.find_edge(x, y) == xy);
+  REQUIRE(graph.has_cycle_before_partition() == false);
+
+  // ids are dense and every edge points forward
+  const pasta::FrozenGraph& g = graph.freeze();
+  REQUIRE(g.num_ids() == g.num_nodes());
+  for(uint32_t v : g.ids) {
+    for(size_t e=g.fanout_offsets[v]; e<g.fanout_offsets[v+1]; e++) {
+      REQUIRE(g.fanouts[e] > v);
+    }
+  }
+
+  // edits after compaction work as before
+  graph.remove_edge(xy);
+  graph.remove_node(x);
+  REQUIRE(graph.num_fanins(y) == 0);
+  graph.set_partition_size(10);
+  graph.partition_c_pasta();
+  REQUIRE(graph.has_cycle_after_partition() == false);
+}
+
+TEST_CASE("text parser.") {
+
+  // whitespace between tokens is free-form, including line breaks inside a statement
+  std::string path = "check_graph_ops_parser.txt";
+  {
+    std::ofstream out(path);
+    out << "4\n\"a\";\n\"b\";  \"c\";\n\"d\";\n"
+        << "\"a\" -> \"b\";\n"
+        << "\"a\"\n  -> \"c\";\n"
+        << "\"b\" ->\"d\";\"c\" -> \"d\";\n";
+  }
+  pasta::Graph graph(path);
+  std::remove(path.c_str());
+
+  REQUIRE(graph.num_nodes() == 4);
+  REQUIRE(graph.num_edges() == 4);
+  REQUIRE(graph.num_fanouts(graph.find_node("a")) == 2);
+  REQUIRE(graph.num_fanins(graph.find_node("d")) == 2);
+  REQUIRE(graph.contains(graph.find_edge(graph.find_node("c"), graph.find_node("d"))) == true);
+}
+
+TEST_CASE("binary round trip.") {
+
+  pasta::Graph graph("../../benchmarks/c6288.txt");
+  std::mt19937 gen(5);
+  graph.remove_random_nodes(50, gen);
+  graph.add_random_edges(50, gen);
+
+  std::string path = "check_graph_ops_c6288.bin";
+  graph.save_binary(path);
+
+  // the file constructor recognizes the binary format
+  pasta::Graph loaded(path);
+  REQUIRE(loaded.num_nodes() == graph.num_nodes());
+  REQUIRE(loaded.num_edges() == graph.num_edges());
+
+  // same CSR up to the numbering, which follows the node order of the saved graph
+  const pasta::FrozenGraph& g1 = graph.freeze();
+  const pasta::FrozenGraph& g2 = loaded.freeze();
+  std::vector<uint32_t> pos(g1.num_ids());
+  for(size_t i=0; i<g1.ids.size(); i++) {
+    pos[g1.ids[i]] = i;
+  }
+  for(size_t i=0; i<g1.ids.size(); i++) {
+    uint32_t v1 = g1.ids[i];
+    uint32_t v2 = g2.ids[i];
+    REQUIRE(g1.num_fanouts(v1) == g2.num_fanouts(v2));
+    for(size_t e=0; e<g1.num_fanouts(v1); e++) {
+      REQUIRE(pos[g1.fanouts[g1.fanout_offsets[v1]+e]] == g2.fanouts[g2.fanout_offsets[v2]+e]);
+    }
+  }
+  REQUIRE(loaded.contains(loaded.find_node("1")) == graph.contains(graph.find_node("1")));
+
+  // load_binary only fills an empty graph and rejects other files
+  REQUIRE_THROWS_AS(loaded.load_binary(path), std::runtime_error);
+  pasta::Graph empty;
+  REQUIRE_THROWS_AS(empty.load_binary("../../benchmarks/c17.txt"), std::runtime_error);
+  REQUIRE(empty.num_nodes() == 0);
+  empty.load_binary(path);
+  REQUIRE(empty.num_edges() == graph.num_edges());
+  std::remove(path.c_str());
+}
+
+TEST_CASE("partition warm start.") {
+
+  std::string graph_path = "check_graph_ops_c6288_pt.bin";
+  std::string path = "check_graph_ops_c6288.pt";
+  std::string path2 = "check_graph_ops_c6288_2.pt";
+
+  auto read_file = [](const std::string& p) {
+    std::ifstream in(p, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  };
+
+  pasta::Graph graph("../../benchmarks/c6288.txt");
+  graph.set_partition_size(10);
+  graph.partition_c_pasta();
+  graph.partition_cudaflow(4);
+  graph.save_binary(graph_path);
+  graph.save_partition(path);
+
+  // the hash ignores ids and insertion order
+  pasta::Graph same(graph_path);
+  REQUIRE(same.content_hash() == graph.content_hash());
+  pasta::Graph other;
+  REQUIRE(other.load_partition("no_such_file.pt") == false);
+
+  // a missing file or another partition size is not an error, just a cold start
+  same.set_partition_size(20);
+  REQUIRE(same.load_partition(path) == false);
+
+  // unchanged graph: the partition comes back as it was saved
+  same.set_partition_size(0);
+  REQUIRE(same.load_partition(path) == true);
+  REQUIRE(same.has_cycle_after_partition() == false);
+  REQUIRE(same.is_cudaflow_partition_share_same_topo_order() == true);
+  same.save_partition(path2);
+  REQUIRE(read_file(path2) == read_file(path));
+
+  // edited graph: the clusters are repaired and the streams recomputed
+  std::mt19937 gen(7);
+  same.remove_random_nodes(100, gen);
+  same.add_random_edges(100, gen);
+  same.add_random_nodes(100, gen);
+  REQUIRE(same.content_hash() != graph.content_hash());
+  REQUIRE(same.load_partition(path) == true);
+  REQUIRE(same.has_cycle_after_partition() == false);
+  REQUIRE(same.is_cudaflow_partition_share_same_topo_order() == true);
+
+  // corrupt files are rejected
+  std::ofstream(path2, std::ios::binary) << read_file(path).substr(0, 100);
+  REQUIRE_THROWS_AS(same.load_partition(path2), std::runtime_error);
+
+  // repeated incremental streams replace the stream edges instead of adding to them
+  graph.partition_cudaflow_incremental(4);
+  graph.save_partition(path);
+  graph.partition_cudaflow_incremental(4);
+  graph.save_partition(path2);
+  REQUIRE(read_file(path2) == read_file(path));
+  pasta::Graph restored(graph_path);
+  REQUIRE(restored.load_partition(path2) == true);
+  REQUIRE(restored.is_incre_cudaflow_partition_share_same_topo_order() == true);
+  restored.save_partition(path2);
+  REQUIRE(read_file(path2) == read_file(path));
+
+  std::remove(graph_path.c_str());
+  std::remove(path.c_str());
+  std::remove(path2.c_str());
+}
+
+TEST_CASE("incremental partition.") {
+
+  std::string graph_path = "check_graph_ops_c6288_incre.bin";
+  std::string path = "check_graph_ops_c6288_incre.pt";
+
+  pasta::Graph graph("../../benchmarks/c6288.txt");
+  graph.set_partition_size(10);
+
+  // the first call partitions from scratch
+  graph.partition_c_pasta_incremental();
+  REQUIRE(graph.has_cycle_after_partition() == false);
+  REQUIRE(graph.is_c_pasta_partition_consistent() == true);
+
+  // random edges often run into an earlier cluster and move their heads
+  std::mt19937 gen(11);
+  for(int i=0; i<100; i++) {
+    graph.remove_random_edges(3, gen);
+    graph.remove_random_nodes(2, gen);
+    graph.add_random_edges(3, gen);
+    graph.add_random_nodes(2, gen);
+    graph.partition_c_pasta_incremental();
+    REQUIRE(graph.has_cycle_after_partition() == false);
+    REQUIRE(graph.is_c_pasta_partition_consistent() == true);
+  }
+
+  // saved clusters are renumbered in rank order and restore as they are
+  graph.save_binary(graph_path);
+  graph.save_partition(path);
+  pasta::Graph same(graph_path);
+  REQUIRE(same.load_partition(path) == true);
+  REQUIRE(same.has_cycle_after_partition() == false);
+  REQUIRE(same.is_c_pasta_partition_consistent() == true);
+
+  // a full partition or a new partition size starts the tracking over
+  graph.partition_c_pasta();
+  graph.add_random_edges(10, gen);
+  graph.partition_c_pasta_incremental();
+  REQUIRE(graph.has_cycle_after_partition() == false);
+  REQUIRE(graph.is_c_pasta_partition_consistent() == true);
+  graph.set_partition_size(4);
+  graph.partition_c_pasta_incremental();
+  REQUIRE(graph.is_c_pasta_partition_consistent() == true);
+
+  std::remove(graph_path.c_str());
+  std::remove(path.c_str());
+}
+
+TEST_CASE("cost-weighted partition.") {
+
+  // a declaration may carry a cost, the default is 1
+  std::string path = "check_graph_ops_costs.txt";
+  std::string graph_path = "check_graph_ops_costs.bin";
+  std::ofstream(path) << "4\n\"a\" 3;\n\"b\";\n\"c\" 12;\n\"d\" 2;\n"
+                      << "\"a\" -> \"b\";\n\"a\" -> \"c\";\n\"b\" -> \"d\";\n\"c\" -> \"d\";\n";
+  pasta::Graph small(path);
+  REQUIRE(small.cost(small.find_node("a")) == 3);
+  REQUIRE(small.cost(small.find_node("b")) == 1);
+  REQUIRE(small.cost(small.find_node("c")) == 12);
+  REQUIRE_THROWS_AS(small.set_cost(small.find_node("a"), 0), std::runtime_error);
+
+  // a node costlier than the budget gets a cluster of its own
+  small.set_partition_size(5);
+  small.partition_c_pasta();
+  REQUIRE(small.has_cycle_after_partition() == false);
+  REQUIRE(small.is_c_pasta_partition_consistent() == true);
+
+  // costs survive the binary format and change the content hash
+  small.save_binary(graph_path);
+  pasta::Graph same(graph_path);
+  REQUIRE(same.cost(same.find_node("c")) == 12);
+  REQUIRE(same.content_hash() == small.content_hash());
+  same.set_cost(same.find_node("c"), 1);
+  REQUIRE(same.content_hash() != small.content_hash());
+
+  // skewed costs on a larger graph, from scratch and incrementally
+  pasta::Graph graph("../../benchmarks/c6288.txt");
+  std::mt19937 gen(5);
+  std::vector<pasta::NodeId> ids;
+  for(size_t i=0; i<graph.num_nodes(); i++) {
+    pasta::NodeId id = graph.find_node(std::to_string(i));
+    if(graph.contains(id)) {
+      graph.set_cost(id, gen() % 8 == 0 ? 20 : 1);
+      ids.push_back(id);
+    }
+  }
+  graph.set_partition_size(16);
+  graph.partition_c_pasta();
+  REQUIRE(graph.has_cycle_after_partition() == false);
+  REQUIRE(graph.is_c_pasta_partition_consistent() == true);
+
+  graph.partition_c_pasta_incremental();
+  for(int i=0; i<50; i++) {
+    graph.set_cost(ids[gen() % ids.size()], 1 + gen() % 12);
+    graph.add_random_edges(2, gen);
+    graph.partition_c_pasta_incremental();
+    REQUIRE(graph.has_cycle_after_partition() == false);
+    REQUIRE(graph.is_c_pasta_partition_consistent() == true);
+  }
+
+  std::remove(path.c_str());
+  std::remove(graph_path.c_str());
+}
+
+TEST_CASE("critical-path partition.") {
+
+  // a wide fanout next to a long chain: s -> t0..t7 and s -> a -> b -> c
+  pasta::Graph graph;
+  pasta::NodeId s = graph.insert_node("s");
+  std::vector<pasta::NodeId> chain {s};
+  for(auto name : {"a", "b", "c"}) {
+    chain.push_back(graph.insert_node(name));
+    graph.insert_edge(chain[chain.size()-2], chain.back());
+  }
+  std::vector<pasta::NodeId> fanout;
+  for(int i=0; i<8; i++) {
+    fanout.push_back(graph.insert_node("t" + std::to_string(i)));
+    graph.insert_edge(s, fanout.back());
+  }
+  graph.set_partition_size(10);
+
+  // greedy piles the fanout into the cluster of the chain
+  graph.partition_c_pasta();
+  REQUIRE(graph.cluster_of(fanout[0]) == graph.cluster_of(s));
+
+  // the chain is critical and stays together, the fanout is spread out
+  graph.set_c_pasta_strategy(pasta::CPastaStrategy::CriticalPath, 0);
+  graph.partition_c_pasta();
+  REQUIRE(graph.has_cycle_after_partition() == false);
+  REQUIRE(graph.is_c_pasta_partition_consistent() == true);
+  for(auto v : chain) {
+    REQUIRE(graph.cluster_of(v) == graph.cluster_of(s));
+  }
+  for(auto v : fanout) {
+    REQUIRE(graph.cluster_of(v) != graph.cluster_of(s));
+  }
+
+  // with costs the critical path moves: a costly fanout outweighs the chain
+  graph.set_cost(fanout[3], 10);
+  graph.set_partition_size(20);
+  graph.partition_c_pasta();
+  REQUIRE(graph.cluster_of(fanout[3]) == graph.cluster_of(s));
+  REQUIRE(graph.cluster_of(chain[1]) != graph.cluster_of(s));
+  graph.set_c_pasta_strategy(pasta::CPastaStrategy::CriticalPath, 0, false);
+  graph.partition_c_pasta();
+  REQUIRE(graph.cluster_of(chain[1]) == graph.cluster_of(s));
+
+  // any slack keeps the cluster graph acyclic
+  pasta::Graph circuit("../../benchmarks/c6288.txt");
+  circuit.set_partition_size(16);
+  for(double slack : {0.0, 0.1, 1.0}) {
+    circuit.set_c_pasta_strategy(pasta::CPastaStrategy::CriticalPath, slack);
+    circuit.partition_c_pasta();
+    REQUIRE(circuit.has_cycle_after_partition() == false);
+    REQUIRE(circuit.is_c_pasta_partition_consistent() == true);
+  }
+}
+
+TEST_CASE("deterministic partition.") {
+
+  pasta::Graph graph("../../benchmarks/aes_core.txt");
+  pasta::Graph same("../../benchmarks/aes_core.txt");
+  std::vector<pasta::NodeId> ids, same_ids;
+  for(size_t i=0; i<graph.num_nodes(); i++) {
+    ids.push_back(graph.find_node(std::to_string(i)));
+    same_ids.push_back(same.find_node(std::to_string(i)));
+  }
+
+  for(auto strategy : {pasta::CPastaStrategy::Greedy, pasta::CPastaStrategy::CriticalPath}) {
+    for(auto g : {&graph, &same}) {
+      g->set_partition_size(10);
+      g->set_c_pasta_strategy(strategy);
+      g->set_c_pasta_deterministic(true);
+      g->partition_c_pasta();
+      REQUIRE(g->has_cycle_after_partition() == false);
+      REQUIRE(g->is_c_pasta_partition_consistent() == true);
+    }
+    // the same clusters for every run and every copy of the graph
+    auto clusters_of = [](pasta::Graph& g, const std::vector<pasta::NodeId>& nodes) {
+      std::vector<int> clusters;
+      for(auto id : nodes) {
+        clusters.push_back(g.cluster_of(id));
+      }
+      return clusters;
+    };
+    std::vector<int> clusters = clusters_of(graph, ids);
+    REQUIRE(clusters_of(same, same_ids) == clusters);
+    graph.partition_c_pasta();
+    REQUIRE(clusters_of(graph, ids) == clusters);
+  }
+}
+
+TEST_CASE("oversubscribed partition.") {
+
+  // many more C-PASTA workers than cores on graphs too small to keep them busy:
+  // every run ends, places every node, and leaves a valid cluster graph
+  const size_t num_threads = 4 * std::max(1u, std::thread::hardware_concurrency()) + 3;
+  std::mt19937 gen(23);
+  for(size_t n : {0, 1, 2, 7, 64}) {
+    pasta::Graph graph;
+    std::vector<pasta::NodeId> ids;
+    for(size_t i=0; i<n; i++) {
+      ids.push_back(graph.insert_node(std::to_string(i)));
+    }
+    for(size_t i=0; i<n; i++) {
+      for(size_t j=i+1; j<std::min(n, i+4); j++) {
+        if(gen() % 2) {
+          graph.insert_edge(ids[i], ids[j]);
+        }
+      }
+    }
+    graph.set_partition_size(3);
+    graph.set_c_pasta_num_threads(num_threads);
+    for(int run=0; run<50; run++) {
+      graph.partition_c_pasta();
+      REQUIRE(graph.has_cycle_after_partition() == false);
+      REQUIRE(graph.is_c_pasta_partition_consistent() == true);
+      for(auto id : ids) {
+        REQUIRE(graph.cluster_of(id) >= 0);
+      }
+    }
+  }
+}
+
+TEST_CASE("one cedge per cluster pair.") {
+
+  // s -> {a, b, c} -> t with a partition size of 4: s, a, b and c share a cluster
+  // and t gets its own, so the three edges into t make a single cedge
+  pasta::Graph graph;
+  pasta::NodeId s = graph.insert_node("s");
+  pasta::NodeId t = graph.insert_node("t");
+  for(auto name : {"a", "b", "c"}) {
+    pasta::NodeId v = graph.insert_node(name);
+    graph.insert_edge(s, v);
+    graph.insert_edge(v, t);
+  }
+  graph.set_partition_size(4);
+  graph.partition_c_pasta();
+  REQUIRE(graph.cluster_of(graph.find_node("a")) == graph.cluster_of(s));
+  REQUIRE(graph.cluster_of(graph.find_node("c")) == graph.cluster_of(s));
+  REQUIRE(graph.cluster_of(t) != graph.cluster_of(s));
+  REQUIRE(graph.is_c_pasta_partition_consistent() == true);
+
+  // consistency also checks that every connected pair has exactly one cedge
+  // counting its edges, on a graph with many parallel edges between clusters
+  pasta::Graph circuit("../../benchmarks/aes_core.txt");
+  for(size_t size : {2, 10, 100}) {
+    circuit.set_partition_size(size);
+    circuit.partition_c_pasta();
+    REQUIRE(circuit.has_cycle_after_partition() == false);
+    REQUIRE(circuit.is_c_pasta_partition_consistent() == true);
+  }
+}
+
+TEST_CASE("chain compression.") {
+
+  // a -> b -> c -> {d, e} -> f -> g: chains a-b-c, d, e and f-g
+  pasta::Graph graph;
+  auto a = graph.insert_node("a");
+  auto b = graph.insert_node("b");
+  auto c = graph.insert_node("c");
+  auto d = graph.insert_node("d");
+  auto e = graph.insert_node("e");
+  auto f = graph.insert_node("f");
+  auto g = graph.insert_node("g");
+  graph.insert_edge(a, b);
+  graph.insert_edge(b, c);
+  graph.insert_edge(c, d);
+  graph.insert_edge(c, e);
+  graph.insert_edge(d, f);
+  graph.insert_edge(e, f);
+  graph.insert_edge(f, g);
+
+  const pasta::ChainCompression& chains = graph.compress_chains();
+  REQUIRE(chains.num_nodes() == 4);
+  REQUIRE(chains.graph.fanins.size() == 4);
+  REQUIRE(chains.members.size() == 7);
+  for(uint32_t s=0; s<chains.num_nodes(); s++) {
+    for(size_t i=chains.member_offsets[s]; i<chains.member_offsets[s+1]; i++) {
+      REQUIRE(chains.super_of[chains.members[i]] == s);
+    }
+  }
+
+  // a cost cap cuts a-b-c, and the cache follows cost changes
+  REQUIRE(graph.compress_chains(2).num_nodes() == 5);
+  graph.set_cost(g, 2);
+  REQUIRE(graph.compress_chains(2).num_nodes() == 6);
+  REQUIRE(*std::max_element(chains.cost.begin(), chains.cost.end()) == 2);
+
+  // a chain that fits the partition size stays in one cluster
+  graph.set_chain_compression(true);
+  graph.set_partition_size(3);
+  graph.partition_c_pasta();
+  REQUIRE(graph.has_cycle_after_partition() == false);
+  REQUIRE(graph.is_c_pasta_partition_consistent() == true);
+  REQUIRE(graph.cluster_of(a) == graph.cluster_of(c));
+
+  // every partitioner stays valid on a real circuit
+  pasta::Graph circuit("../../benchmarks/aes_core.txt");
+  REQUIRE(circuit.compress_chains().num_nodes() < circuit.num_nodes());
+  circuit.set_chain_compression(true);
+  circuit.set_partition_size(10);
+  for(bool deterministic : {false, true}) {
+    for(auto strategy : {pasta::CPastaStrategy::Greedy, pasta::CPastaStrategy::CriticalPath}) {
+      circuit.set_c_pasta_deterministic(deterministic);
+      circuit.set_c_pasta_strategy(strategy, 0.1, false);
+      circuit.partition_c_pasta();
+      REQUIRE(circuit.has_cycle_after_partition() == false);
+      REQUIRE(circuit.is_c_pasta_partition_consistent() == true);
+    }
+  }
+  circuit.partition_cudaflow(4);
+  REQUIRE(circuit.is_cudaflow_partition_share_same_topo_order() == true);
+  circuit.partition_cudaflow_incremental(4);
+  REQUIRE(circuit.is_incre_cudaflow_partition_share_same_topo_order() == true);
+}
+
+TEST_CASE("multilevel partition.") {
+
+  pasta::Graph graph("../../benchmarks/aes_core.txt");
+  std::vector<pasta::NodeId> ids;
+  for(size_t i=0; i<graph.num_nodes(); i++) {
+    ids.push_back(graph.find_node(std::to_string(i)));
+  }
+  auto num_clusters = [&graph, &ids]() {
+    std::set<int> clusters;
+    for(auto id : ids) {
+      if(graph.contains(id)) {
+        clusters.insert(graph.cluster_of(id));
+      }
+    }
+    return clusters.size();
+  };
+
+  graph.set_partition_size(10);
+  graph.partition_c_pasta();
+  size_t num_c_pasta_clusters = num_clusters();
+
+  for(auto strategy : {pasta::CPastaStrategy::Greedy, pasta::CPastaStrategy::CriticalPath}) {
+    graph.set_c_pasta_strategy(strategy);
+    graph.partition_multilevel();
+    REQUIRE(graph.has_cycle_after_partition() == false);
+    REQUIRE(graph.is_c_pasta_partition_consistent() == true);
+  }
+  // coarsening and refinement fill the clusters better than a single greedy pass
+  graph.set_c_pasta_strategy(pasta::CPastaStrategy::Greedy);
+  graph.partition_multilevel();
+  REQUIRE(num_clusters() < num_c_pasta_clusters);
+
+  // costs and edits since the last partition are picked up
+  std::mt19937 gen(7);
+  graph.set_cost(ids[0], 25);
+  graph.remove_random_nodes(100, gen);
+  graph.add_random_edges(100, gen);
+  graph.partition_multilevel();
+  REQUIRE(graph.has_cycle_after_partition() == false);
+  REQUIRE(graph.is_c_pasta_partition_consistent() == true);
+}
+
+TEST_CASE("changelog replay.") {
+
+  std::string text_path = "check_graph_ops.cl";
+  std::string binary_path = "check_graph_ops.clb";
+
+  std::ofstream(text_path) <<
+    "batch;\n"
+    "- \"a\" -> \"b\";\n"
+    "+ \"x\";\n"
+    "+ \"a\" -> \"x\";\n"
+    "+ \"x\" -> \"b\";\n"
+    "batch;\n"
+    "batch;\n"
+    "- \"c\";\n"
+    "+ \"y\";\n"
+    "+ \"x\" -> \"y\";\n";
+
+  // the reader splits the file into batches
+  pasta::ChangelogReader reader(text_path);
+  pasta::ChangeBatch batch;
+  REQUIRE(reader.next(batch) == true);
+  REQUIRE(batch.remove_edges.size() == 1);
+  REQUIRE(batch.insert_nodes.size() == 1);
+  REQUIRE(batch.insert_edges.size() == 2);
+  REQUIRE(reader.next(batch) == true);
+  REQUIRE(batch.empty() == true);
+  REQUIRE(reader.next(batch) == true);
+  REQUIRE(batch.remove_nodes.size() == 1);
+  REQUIRE(reader.next(batch) == false);
+  REQUIRE(reader.num_batches() == 3);
+
+  // the same batches through the binary format
+  {
+    pasta::ChangelogReader text(text_path);
+    pasta::ChangelogWriter writer(binary_path, true);
+    while(text.next(batch)) {
+      writer.write(batch);
+    }
+  }
+
+  for(auto path : {text_path, binary_path}) {
+    pasta::Graph graph;
+    pasta::NodeId a = graph.insert_node("a");
+    pasta::NodeId b = graph.insert_node("b");
+    pasta::NodeId c = graph.insert_node("c");
+    graph.insert_edge(a, b);
+    graph.insert_edge(b, c);
+
+    std::vector<size_t> batches;
+    REQUIRE(graph.replay(path, pasta::RunMode::None, 8, [&](size_t i) { batches.push_back(i); }) == 3);
+    REQUIRE(batches == std::vector<size_t>{0, 1, 2});
+    REQUIRE(graph.num_nodes() == 4);
+    REQUIRE(graph.num_edges() == 3);
+    REQUIRE(graph.contains(c) == false);
+    pasta::NodeId x = graph.find_node("x");
+    REQUIRE(graph.find_edge(a, b) == pasta::EdgeId{});
+    REQUIRE(graph.find_edge(a, x) != pasta::EdgeId{});
+    REQUIRE(graph.find_edge(x, graph.find_node("y")) != pasta::EdgeId{});
+  }
+
+  // an invalid batch stops the replay, the batches before it stay applied
+  std::ofstream(text_path) <<
+    "batch;\n"
+    "+ \"x\";\n"
+    "batch;\n"
+    "+ \"x\" -> \"z\";\n";
+  pasta::Graph graph;
+  REQUIRE_THROWS_AS(graph.replay(text_path), std::runtime_error);
+  REQUIRE(graph.num_nodes() == 1);
+
+  std::ofstream(text_path) << "+ \"x\";\n";
+  REQUIRE_THROWS_AS(graph.replay(text_path), std::runtime_error);
+
+  // writer -> reader keeps the kind of every record, also edges to a node named ""
+  pasta::ChangeBatch written;
+  written.remove_edges.emplace_back("a", "");
+  written.remove_nodes.push_back("");
+  written.insert_nodes.push_back("b c");
+  written.insert_edges.emplace_back("", "b c");
+  for(bool binary : {false, true}) {
+    {
+      pasta::ChangelogWriter writer(text_path, binary);
+      writer.write(written);
+    }
+    pasta::ChangelogReader read(text_path);
+    REQUIRE(read.next(batch) == true);
+    REQUIRE(batch.remove_edges == written.remove_edges);
+    REQUIRE(batch.remove_nodes == written.remove_nodes);
+    REQUIRE(batch.insert_nodes == written.insert_nodes);
+    REQUIRE(batch.insert_edges == written.insert_edges);
+    REQUIRE(read.next(batch) == false);
+  }
+
+  // names with quotes or line breaks only fit the binary format
+  pasta::ChangeBatch odd;
+  odd.insert_nodes.push_back("say \"hi\"");
+  odd.insert_edges.emplace_back("line\nbreak", "x");
+  for(bool binary : {false, true}) {
+    {
+      pasta::ChangelogWriter writer(text_path, binary);
+      if(!binary) {
+        REQUIRE_THROWS_AS(writer.write(odd), std::runtime_error);
+        continue;
+      }
+      writer.write(odd);
+    }
+    pasta::ChangelogReader read(text_path);
+    REQUIRE(read.next(batch) == true);
+    REQUIRE(batch.insert_nodes == odd.insert_nodes);
+    REQUIRE(batch.insert_edges == odd.insert_edges);
+  }
+
+  std::remove(text_path.c_str());
+  std::remove(binary_path.c_str());
+}
+
+TEST_CASE("dag generator.") {
+
+  std::string text_path = "check_graph_ops_gen.txt";
+  std::string binary_path = "check_graph_ops_gen.bin";
+
+  for(auto shape : {pasta::DagShape::Layered, pasta::DagShape::Random, pasta::DagShape::Circuit}) {
+    for(auto degree : {pasta::DegreeDistribution::Fixed, pasta::DegreeDistribution::Geometric,
+                       pasta::DegreeDistribution::PowerLaw}) {
+      pasta::DagSpec spec;
+      spec.shape = shape;
+      spec.degree = degree;
+      spec.num_nodes = 5000;
+      spec.depth = 40;
+      spec.seed = 11;
+
+      pasta::DagStats text = pasta::generate_dag(spec, text_path);
+      pasta::DagStats binary = pasta::generate_dag(spec, binary_path, true);
+      REQUIRE(text.num_nodes == 5000);
+      REQUIRE(text.depth == 40);
+      REQUIRE(text.num_edges == binary.num_edges);
+
+      // both formats hold the same acyclic graph
+      pasta::Graph g1(text_path);
+      pasta::Graph g2(binary_path);
+      REQUIRE(g1.num_nodes() == 5000);
+      REQUIRE(g1.num_edges() == text.num_edges);
+      REQUIRE(g1.content_hash() == g2.content_hash());
+      REQUIRE(g1.has_cycle_before_partition() == false);
+
+      // only level 0 has sources
+      const pasta::FrozenGraph& g = g1.freeze();
+      size_t num_sources = 0;
+      for(uint32_t v : g.ids) {
+        num_sources += (g.num_fanins(v) == 0);
+      }
+      REQUIRE(num_sources == 125);
+    }
+  }
+
+  // a deep Random graph keeps its fanins within the default span, so the binary
+  // writer only buffers that many levels
+  pasta::DagSpec deep;
+  deep.shape = pasta::DagShape::Random;
+  deep.depth = 200;
+  deep.width = 20;
+  deep.seed = 3;
+  pasta::DagStats stats = pasta::generate_dag(deep, binary_path, true);
+  pasta::Graph deep_graph(binary_path);
+  REQUIRE(deep_graph.num_edges() == stats.num_edges);
+  const pasta::FrozenGraph& g = deep_graph.freeze();
+  std::vector<size_t> position(g.num_ids());
+  for(size_t i=0; i<g.ids.size(); i++) {
+    position[g.ids[i]] = i; // nodes are loaded in file order, node i is named "i"
+  }
+  size_t max_skip = 0;
+  for(uint32_t v : g.ids) {
+    for(size_t e=g.fanout_offsets[v]; e<g.fanout_offsets[v+1]; e++) {
+      max_skip = std::max(max_skip, position[g.fanouts[e]] / 20 - position[v] / 20);
+    }
+  }
+  REQUIRE(max_skip > 1);
+  REQUIRE(max_skip <= 16);
+
+  pasta::DagSpec spec;
+  spec.num_nodes = 0;
+  REQUIRE_THROWS_AS(pasta::generate_dag(spec, text_path), std::runtime_error);
+
+  std::remove(text_path.c_str());
+  std::remove(binary_path.c_str());
+}
+
+
+TEST_CASE("cone-restricted loading.") {
+
+  std::string text_path = "../../benchmarks/c6288.txt";
+  std::string binary_path = "check_graph_ops_cone.bin";
+  std::string index_path = "check_graph_ops_cone.idx";
+  std::string text_index_path = "check_graph_ops_cone_text.idx";
+
+  pasta::Graph full(text_path);
+  full.save_binary(binary_path);
+  pasta::Graph::build_cone_index(binary_path, index_path);
+  pasta::Graph::build_cone_index(text_path, text_index_path);
+
+  // a fanin (fanout) cone keeps all fanins (fanouts) of its nodes, and the roots
+  // are its only sinks (sources)
+  auto check = [&](pasta::Graph& cone, const std::vector<std::string>& roots, pasta::ConeDirection direction) {
+    size_t num_found = 0;
+    for(size_t i=0; i<full.num_nodes(); i++) {
+      std::string name = std::to_string(i);
+      pasta::NodeId v = cone.find_node(name);
+      if(!cone.contains(v)) {
+        continue;
+      }
+      ++num_found;
+      pasta::NodeId w = full.find_node(name);
+      bool is_root = std::find(roots.begin(), roots.end(), name) != roots.end();
+      if(direction == pasta::ConeDirection::Fanin) {
+        REQUIRE(cone.num_fanins(v) == full.num_fanins(w));
+        REQUIRE((cone.num_fanouts(v) == 0) == is_root);
+      }
+      else {
+        REQUIRE(cone.num_fanouts(v) == full.num_fanouts(w));
+        REQUIRE((cone.num_fanins(v) == 0) == is_root);
+      }
+    }
+    REQUIRE(num_found == cone.num_nodes());
+  };
+
+  std::vector<std::string> sinks = {"4836", "3000"};
+  std::vector<std::string> sources = {"0"};
+
+  // text and binary give the same cone
+  pasta::Graph fanin_text(text_path, sinks, pasta::ConeDirection::Fanin, text_index_path);
+  pasta::Graph fanin_binary(binary_path, sinks, pasta::ConeDirection::Fanin, index_path);
+  check(fanin_text, sinks, pasta::ConeDirection::Fanin);
+  REQUIRE(fanin_text.num_nodes() > 1);
+  REQUIRE(fanin_text.num_nodes() < full.num_nodes());
+  REQUIRE(fanin_text.content_hash() == fanin_binary.content_hash());
+
+  pasta::Graph fanout_text(text_path, sources, pasta::ConeDirection::Fanout, text_index_path);
+  pasta::Graph fanout_binary(binary_path, sources, pasta::ConeDirection::Fanout, index_path);
+  check(fanout_text, sources, pasta::ConeDirection::Fanout);
+  REQUIRE(fanout_text.num_nodes() > 1);
+  REQUIRE(fanout_text.content_hash() == fanout_binary.content_hash());
+
+  // a cone graph is an ordinary graph
+  fanin_text.set_partition_size(10);
+  fanin_text.partition_c_pasta();
+  REQUIRE(fanin_text.has_cycle_after_partition() == false);
+
+  // a cone cut from a cost-weighted graph keeps the costs
+  for(size_t i=0; i<full.num_nodes(); i+=7) {
+    full.set_cost(full.find_node(std::to_string(i)), static_cast<uint32_t>(1 + i % 5));
+  }
+  full.save_binary(binary_path);
+  pasta::Graph::build_cone_index(binary_path, index_path);
+  pasta::Graph weighted(binary_path, sinks, pasta::ConeDirection::Fanin, index_path);
+  REQUIRE(weighted.num_nodes() == fanin_text.num_nodes());
+  size_t num_weighted = 0;
+  for(size_t i=0; i<full.num_nodes(); i++) {
+    pasta::NodeId v = weighted.find_node(std::to_string(i));
+    if(weighted.contains(v)) {
+      REQUIRE(weighted.cost(v) == full.cost(full.find_node(std::to_string(i))));
+      num_weighted += (weighted.cost(v) > 1);
+    }
+  }
+  REQUIRE(num_weighted > 0);
+
+  std::remove(binary_path.c_str());
+  std::remove(index_path.c_str());
+  std::remove(text_index_path.c_str());
+}